@@ -1,13 +1,109 @@
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE // madvise() and MADV_* in strict -std=c11 builds, see mapFile()
+#endif
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <time.h>
 #include <string.h>
 #include <math.h>
 #include <ctype.h>
+#include <stdatomic.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h> // batch engine, see batchResolve()
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#define MADV_SEQUENTIAL 0 // mapFile() access hints, Windows has none
+#define MADV_RANDOM 0
+#else
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #define MOVES_COUNT 5
 #define SHIPS_COUNT 4
 #define GRID_SIZE 10
+#define BOT_DIFFICULTIES 5 // see enum botDifficulty
+
+// instrumentation: build with -DINSTRUMENT to count calls, cycles and events of the hot paths and
+// print them at exit; without it every probe below expands to nothing
+#ifdef INSTRUMENT
+enum probe
+{
+    probeMakeMove,
+    probeFire,
+    probeRadarSweep,
+    probeSmokeScreen,
+    probeArtillery,
+    probeTorpedo,
+    probeSetCoordsMeaningfully,
+    probeSearchForHits,
+    probeCellSetContains,
+    probeTranspositionProbe,
+    PROBES
+};
+
+enum counter
+{
+    counterRngDraws,
+    counterAllocations,
+    counterFleetAttempts,     // sampleFleet() redraws, the retry loop of bot ship placement
+    counterRadarRetries,      // random top-left retries in radarSweep()
+    counterArtilleryRetries,  // random top-left retries in artillery()
+    counterRandomRetries,     // random cell retries in fire() and searchForHits()
+    counterCellSetAdds,
+    counterCellSetLength,     // sum of set lengths after each add
+    counterMonteCarloAttempts,
+    counterTranspositionProbes,
+    counterTranspositionHits,
+    counterTranspositionStores,
+    counterTablebaseProbes,
+    counterTablebaseHits,
+    counterOpeningProbes,
+    counterOpeningHits,
+    COUNTERS
+};
+
+typedef struct instrumentTable
+{
+    uint64_t calls[PROBES];
+    uint64_t cycles[PROBES];
+    uint64_t counters[COUNTERS];
+} InstrumentTable;
+
+#define PROBE_BEGIN(probe) uint64_t probeStart = readCycles()
+#define PROBE_END(probe) probeRecord(probe, probeStart)
+#define PROBE_RETURN(probe, value) \
+    do                             \
+    {                              \
+        PROBE_END(probe);          \
+        return value;              \
+    } while (0)
+#define PROBE_RETURN_VOID(probe) \
+    do                           \
+    {                            \
+        PROBE_END(probe);        \
+        return;                  \
+    } while (0)
+#define COUNT(counter, n) (instrumentLocal.counters[counter] += (n))
+#define INSTRUMENT_FLUSH() instrumentFlush()
+#define INSTRUMENT_REPORT() instrumentReport()
+#else
+#define PROBE_BEGIN(probe)
+#define PROBE_END(probe)
+#define PROBE_RETURN(probe, value) return value
+#define PROBE_RETURN_VOID(probe) return
+#define COUNT(counter, n)
+#define INSTRUMENT_FLUSH()
+#define INSTRUMENT_REPORT()
+#endif
 
 // stucts
 typedef struct ship
@@ -23,36 +119,536 @@ typedef struct move
     int shipsSunkToUnlock;
 } Move;
 
-typedef struct cell // Define and typedef Cell the same time
+typedef struct bitboard // one bit per cell, bit row * GRID_SIZE + col: cells 0..63 in lo, 64..99 in hi
 {
-    int col;
+    uint64_t lo;
+    uint64_t hi;
+} Bitboard;
+
+typedef struct cellSet // fixed capacity, every cell of the grid at most once
+{
+    Bitboard members;                          // constant-time membership
+    int count;
+    unsigned char cells[GRID_SIZE * GRID_SIZE]; // row * GRID_SIZE + col, oldest first: the front (newest) is cells[count - 1]
+} CellSet;
+
+typedef struct rng // xoshiro256** state, see rngNext()
+{
+    uint64_t s[4];
+} Rng;
+
+typedef struct board
+{
+    Bitboard ships;                 // cells occupied by any ship
+    Bitboard shipMask[SHIPS_COUNT]; // cells of each ship, index: ship size - 2 (like Player.ships)
+    unsigned char shipAt[GRID_SIZE * GRID_SIZE]; // ship index + 1 on every cell, 0: water
+    Bitboard hits;
+    Bitboard misses;
+    Bitboard smoke; // hidden from radar sweeps
+} Board;
+
+#define MAX_SHIP_SIZE 5
+#define MAX_PLACEMENTS (2 * GRID_SIZE * (GRID_SIZE - 1)) // legal placements of the smallest ship
+#define MAX_DENSITY 28                                   // a cell lies in at most 2 * (5 + 4 + 3 + 2) placements
+
+typedef struct placementTable // every legal placement of every ship, built once at startup
+{
+    int count[SHIPS_COUNT];                                        // placements of ship k (size k + 2)
+    Bitboard mask[SHIPS_COUNT][MAX_PLACEMENTS];                    // their cells
+    unsigned char cells[SHIPS_COUNT][MAX_PLACEMENTS][MAX_SHIP_SIZE]; // the same cells, top-left first
+    int coverCount[SHIPS_COUNT][GRID_SIZE * GRID_SIZE];            // placements of ship k covering each cell
+    unsigned char cover[SHIPS_COUNT][GRID_SIZE * GRID_SIZE][2 * MAX_SHIP_SIZE]; // and their indices
+} PlacementTable;
+
+typedef struct fleet // one placement index per ship (size k + 2 at index k), see placements
+{
+    unsigned char placement[SHIPS_COUNT];
+} Fleet;
+
+typedef struct densityTracker // the density bot's placement counts, kept up to date shot by shot
+{
+    unsigned char valid[SHIPS_COUNT][MAX_PLACEMENTS]; // placement still possible
+    unsigned char density[GRID_SIZE * GRID_SIZE];     // valid placements of ships afloat covering the cell
+    Bitboard bucket[MAX_DENSITY + 1];                 // undiscovered cells by density
+    int top;                                          // no bucket above it holds a cell
+    Bitboard blocked;                                 // misses and sunk cells already applied
+    Bitboard discovered;                              // cells already taken out of the buckets
+    int sunkApplied;                                  // bit k: placements of ship k already removed
+} DensityTracker;
+
+typedef struct monteCarloConfig // per-move budget of the Monte Carlo bot, whichever runs out first
+{
+    long samples;     // consistent fleets to draw, 0: no limit
+    int milliseconds; // wall time, 0: no limit
+    int threads;      // 0: one per core
+} MonteCarloConfig;
+
+typedef struct monteCarloEvidence // what the bot knows about the opponent's fleet, rebuilt every move
+{
+    unsigned char valid[SHIPS_COUNT][MAX_PLACEMENTS];     // placement still possible
+    int count[SHIPS_COUNT];                               // placements of ship k still possible
+    unsigned char placement[SHIPS_COUNT][MAX_PLACEMENTS]; // and their indices
+    Bitboard occupied;                                    // hits and radar contacts: every fleet covers them
+    int sunk;                                             // bit k: ship k is sunk, it lies on hits only
+} MonteCarloEvidence;
+
+typedef struct monteCarloWorker // one sampling thread of a move
+{
+    MonteCarloEvidence *evidence; // shared, read-only while sampling
+    Rng rng;
+    long samples;    // fleets to accept, 0: until the deadline
+    double deadline; // wallSeconds() to stop at, 0: none
+    long accepted;
+    long attempts;
+    double weight;                       // of all accepted fleets
+    double cover[GRID_SIZE * GRID_SIZE]; // weight of the accepted fleets covering each cell
+} MonteCarloWorker;
+
+#define ZOBRIST_COUNTS 16     // countAvailable values with keys of their own, higher ones share the last
+#define TRANSPOSITION_BITS 16 // 2^16 entries, 1 MB
+
+typedef struct zobristKeys // one random key per fact a bot can know, see observationKey()
+{
+    uint64_t hit[GRID_SIZE * GRID_SIZE];
+    uint64_t miss[GRID_SIZE * GRID_SIZE];
+    uint64_t radared[GRID_SIZE * GRID_SIZE]; // swept by the bot's radar
+    uint64_t found[GRID_SIZE * GRID_SIZE];   // radar contacts
+    uint64_t sunk[SHIPS_COUNT];
+    uint64_t available[MOVES_COUNT][ZOBRIST_COUNTS];
+    uint64_t smoke;               // the opponent has laid a smoke screen, see smokeLaid()
+    uint64_t target[MOVES_COUNT]; // which move a cached target is for
+} ZobristKeys;
+
+typedef struct transpositionEntry // written and read without locks: check is key ^ data, so a pair torn by two stores fails it
+{
+    _Atomic uint64_t check;
+    _Atomic uint64_t data; // 0: empty
+} TranspositionEntry;
+
+#define ENDGAME_SHIPS 2                              // ships afloat at most for the solver to take over
+#define ENDGAME_MAX_CONFIGS 256                      // highest threshold: a search state has one bit per configuration
+#define ENDGAME_WORDS (ENDGAME_MAX_CONFIGS / 64)
+#define ENDGAME_MEMO_BITS 12
+#define ENDGAME_THRESHOLD 12                         // default, see runEndgameBenchmark()
+#define ENDGAME_NODES 20000                          // default headless budget, every solve below the threshold fits
+#define ENDGAME_LOWER (1u << 12)                     // see EndgameEntry
+
+typedef struct endgameConfig // when the Master bot plays the endgame exactly, and how long a move may search
+{
+    int configurations; // threshold: solve once at most this many placements of the ships afloat fit, 0: never
+    long nodes;         // search states to expand, 0: no limit
+    int milliseconds;   // wall time, 0: no limit
+} EndgameConfig;
+
+typedef struct endgameEntry // expected shots of a search state, see endgameSearch()
+{
+    uint64_t subset[ENDGAME_WORDS]; // configurations still possible
+    Bitboard hits;
+    uint32_t counts;     // radar, artillery and torpedo left, 4 bits each; ENDGAME_LOWER: expected is only a lower bound
+    uint32_t generation; // of the solve that wrote it: older entries are empty
+    double expected;
+} EndgameEntry;
+
+typedef struct endgameSolver // a Master bot's, the configurations are enumerated again every move
+{
+    int count;                                          // configurations: placements of the ships afloat that fit the evidence
+    int afloat[ENDGAME_SHIPS];                          // ship indices
+    int afloatCount;
+    int shipsSunk;                                      // the opponent's, before the search
+    int radar;                                          // 0: the opponent has laid smoke, a quiet sweep proves nothing
+    uint32_t weight[ENDGAME_MAX_CONFIGS];               // fleets per configuration: sunk ships may lie several ways
+    Bitboard fleet[ENDGAME_MAX_CONFIGS];                // cells of the ships afloat
+    Bitboard ship[ENDGAME_MAX_CONFIGS][ENDGAME_SHIPS];
+    long nodes;                                         // states expanded so far
+    long maxNodes;
+    double deadline;
+    int aborted;                                        // over budget, the search result is meaningless
+    double expected;                                    // shots left after the move of the last solve, on average
+    uint32_t generation;
+    EndgameEntry memo[1 << ENDGAME_MEMO_BITS];
+} EndgameSolver;
+
+typedef struct arena // bump allocator: everything a game needs, released at once by arenaReset()
+{
+    unsigned char *memory;
+    size_t used;
+    size_t capacity;
+} Arena;
+
+#define ARENA_ALIGN 16
+#define ARENA_ROUND(size) (((size) + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN)
+#define PLAYER_BYTES (ARENA_ROUND(sizeof(Ship) * SHIPS_COUNT) + ARENA_ROUND(sizeof(Move) * MOVES_COUNT) + \
+                      4 * ARENA_ROUND(sizeof(CellSet)) + ARENA_ROUND(sizeof(DensityTracker)) + ARENA_ROUND(sizeof(EndgameSolver)))
+#define GAME_ARENA_BYTES (2 * PLAYER_BYTES) // two bots of any difficulty
+
+// game events: what the engine reports, for whoever listens (the console, logs), see emitEvent()
+enum eventType
+{
+    eventShot,         // fire, artillery or torpedo aimed: move, row, col (-1: the whole column or row)
+    eventHit,          // of the shot: count new hits
+    eventMiss,
+    eventSink,         // ship of the opponent
+    eventRadar,        // sweep at row, col: count ship cells found
+    eventSmoke,        // screen at row, col over the player's own grid: count ship cells hidden
+    eventMoveUnlocked, // move, count now available
+    eventGameOver,     // the player won
+    EVENT_TYPES
+};
+
+typedef struct gameEvent
+{
+    int type;
+    struct player *player;   // who acted
+    struct player *opponent;
+    int move; // move identifier, -1 if none
     int row;
-    struct cell *next; // Correct self-referencing with struct cell*
-} Cell;
+    int col;
+    int ship;  // index into Player.ships, -1 if none
+    int count;
+} GameEvent;
 
-typedef struct cellList
+typedef struct eventSink
 {
-    Cell *head;
-} CellList;
+    void (*handler)(GameEvent *event, void *context);
+    void *context;
+} EventSink;
 
 // player:
 typedef struct player
 {
     char name[100];
-    int **grid;
+    Board board;
     int shipsSunk;
+    int sinking; // bit k: ship k took its last hit, updateGameState() has not counted it yet
     Ship *ships;
     Move *moves;
-    CellList *smokedCells;
+    int silent;   // headless games: no console I/O at all
+    int lastMove; // move identifier of the last completed move, -1 if none
+    Rng *rng;     // random stream of the game this player is in
+    Arena *arena; // holds ships, moves and bot state, NULL: the heap (see freeAll)
+    EventSink *events; // what this player does is reported there, NULL: nobody listens
     // BOT
     int isBot;
     int difficulty;
-    CellList *botsShipsCoord;
-    CellList *botHitList;
-    CellList *radaredList;
-    CellList *foundShips;
+    CellSet *botsShipsCoord;
+    CellSet *botHitList;
+    CellSet *radaredList;
+    CellSet *foundShips;
+    Bitboard sunkCells; // opponent hits the bot attributes to ships it saw sink
+    int sunkSeen;       // bit k: the bot already attributed ship k (size k + 2)
+    DensityTracker *densityTracker; // densityBot only, NULL otherwise
+    EndgameSolver *endgame;         // monteCarloBot only, NULL otherwise
+    struct tablebase *openingBook;  // hardBot with --opening-book only, NULL otherwise
 } Player;
 
+// make/unmake for search: doMove() pushes what a move changed, undoMove() pops it and puts it back
+#define UNDO_DEPTH 256
+
+typedef struct undoRecord // 64 bytes
+{
+    Bitboard newHits;   // on the opponent's grid
+    Bitboard newMisses;
+    Bitboard newSmoke;  // on the player's own grid
+    signed char countAvailable[MOVES_COUNT]; // the player's before the move: updateMoves(), checkOneRoundMoves()
+    signed char lastMove;
+    unsigned char sunk;        // bit k: the move sank ship k of the opponent
+    unsigned char hitList;     // bot lists before the move, new cells only ever go on the end
+    unsigned char radaredList;
+    unsigned char foundShips;
+} UndoRecord;
+
+typedef struct undoStack
+{
+    int depth;
+    UndoRecord records[UNDO_DEPTH];
+} UndoStack;
+
+// compact game state for simulation: no names, no pointers, no bot memory (hit lists, trackers)
+#define PACKED_UNPLACED 255 // placement of a ship not on the board yet
+
+typedef struct packedPlayer // 80 bytes
+{
+    Bitboard ships;
+    Bitboard hits;   // of this player's grid
+    Bitboard misses;
+    Bitboard smoke;
+    unsigned char placement[SHIPS_COUNT];    // index into placements per ship, or PACKED_UNPLACED
+    signed char remainingHits[SHIPS_COUNT];  // like Ship.remainingHits: -1 once the sink was counted
+    signed char countAvailable[MOVES_COUNT]; // like Move.countAvailable: -1 is unlimited
+    unsigned char shipsSunk;
+    signed char lastMove;
+    signed char difficulty; // -1: human
+} PackedPlayer;
+
+typedef struct packedGame // both players, the random stream and the turn: 200 bytes, see packGame()
+{
+    PackedPlayer players[2];
+    Rng rng;
+    unsigned short turns;
+    unsigned char current; // index of the player to move
+} PackedGame;
+
+_Static_assert(sizeof(PackedGame) <= 256, "a packed game has to stay within four cache lines");
+
+// lockstep batch engine: BATCH_LANES games side by side, every step moves one player in each of them
+#define BATCH_LANES 16 // two AVX-512 or four AVX2 registers of 64-bit lanes
+
+typedef struct batchSide // one player of every lane, structure of arrays: element i belongs to lane i
+{
+    uint64_t shipsLo[BATCH_LANES];
+    uint64_t shipsHi[BATCH_LANES];
+    uint64_t hitsLo[BATCH_LANES];
+    uint64_t hitsHi[BATCH_LANES];
+    uint64_t missesLo[BATCH_LANES];
+    uint64_t missesHi[BATCH_LANES];
+    uint64_t maskLo[SHIPS_COUNT][BATCH_LANES];
+    uint64_t maskHi[SHIPS_COUNT][BATCH_LANES];
+    int64_t remainingHits[SHIPS_COUNT][BATCH_LANES];  // like PackedPlayer.remainingHits
+    int64_t countAvailable[MOVES_COUNT][BATCH_LANES]; // like PackedPlayer.countAvailable
+    int64_t shipsSunk[BATCH_LANES];
+} BatchSide;
+
+typedef struct batchEngine
+{
+    BatchSide sides[2];             // the player to move in every lane is sides[step % 2]
+    uint64_t targetLo[BATCH_LANES]; // cells struck this step, none in idle lanes
+    uint64_t targetHi[BATCH_LANES];
+    Rng rng[BATCH_LANES];
+    long game[BATCH_LANES];  // game played in the lane, -1: idle
+    int first[BATCH_LANES];  // player of the game held by sides[0]
+    long step;
+    long next;               // queue: games next .. games - 1 are still to start
+    long games;
+    uint64_t seed;
+} BatchEngine;
+
+#define MAX_HEADLESS_TURNS 1000 // safety net, a real game never gets close
+
+// replay log: a file header, then games back to back, each a game header, one varint per turn
+// (REPLAY_TURN() + 1), a 0 and the winner. See replayBeginGame() for the game header.
+#define REPLAY_MAGIC "BSREPLAY"
+#define REPLAY_VERSION 1
+#define REPLAY_FILE_HEADER 12 // magic, version (4 bytes, little-endian)
+#define REPLAY_GAME_TAG 0x47  // 'G', first byte of every game
+#define REPLAY_BUFFER (1 << 16)
+#define REPLAY_NONE 255 // difficulty of a human, winner of an unfinished game
+// side (1 bit), move (3), target (7: cell, or row / 10 + column for the torpedo), outcome (4: new
+// hits, radar contacts or smoked cells): most turns fit two varint bytes
+#define REPLAY_TURN(side, move, target, outcome) ((side) | (move) << 1 | (target) << 4 | (outcome) << 11)
+
+typedef struct replayWriter
+{
+    FILE *file;
+    Player *players[2]; // of the game being written
+    EventSink sink;     // the players report there while a game is written, see replayEvents()
+    long games;
+    long turns;
+    uint64_t bytes;
+    int failed; // a write came up short (disk full): the file is incomplete
+    size_t used;
+    unsigned char buffer[REPLAY_BUFFER];
+} ReplayWriter;
+
+typedef struct mappedFile // a whole file mapped read-only: nothing is copied, pages come in when touched
+{
+    const unsigned char *data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+} MappedFile;
+
+typedef struct replayReader
+{
+    MappedFile map;
+    size_t offset;
+} ReplayReader;
+
+typedef struct replayGame
+{
+    uint64_t seed;
+    int difficulty[2]; // -1: human
+    int mode;          // tracking difficulty level of the game
+    int first;         // player who moved first
+    unsigned char placement[2][SHIPS_COUNT]; // index into placements of every ship
+    Bitboard fleet[2];                       // all ship cells of each player
+    int turns;
+    int winner; // -1: unfinished, known once replayNextTurn() returned 0
+} ReplayGame;
+
+typedef struct replayTurn
+{
+    int player;
+    int move;
+    int row; // -1 for a torpedo down a column
+    int col; // -1 for a torpedo along a row
+    int outcome;
+} ReplayTurn;
+
+#define REPLAY_CHECKPOINT_INTERVAL 16 // turns between checkpoints: seeking replays at most this many
+
+typedef struct replayEngine // one recorded game re-simulated, any turn of it on demand (replaySeek())
+{
+    ReplayGame game;
+    int turnCount;
+    ReplayTurn turns[MAX_HEADLESS_TURNS];
+    PackedGame checkpoints[MAX_HEADLESS_TURNS / REPLAY_CHECKPOINT_INTERVAL + 1]; // state before turn i * interval
+    Player players[2];   // the game after `turn` turns, no bot memory
+    Rng rng;             // the rules draw nothing, the packed checkpoints carry it along
+    int turn;
+    int mismatches;      // recorded outcomes, unavailable moves and a winner the re-simulation disagrees with
+    int firstMismatch;   // turn of the first one, -1: none
+} ReplayEngine;
+
+// result of one headless bot-vs-bot game:
+typedef struct gameResult
+{
+    int winner;                    // 0: first bot, 1: second bot, -1: turn limit reached
+    int turns;                     // turns taken by both bots together
+    int movesUsed[2][MOVES_COUNT]; // successful moves of each bot, indexed like Player.moves
+    uint64_t seed;                 // replaying the same seed replays the same game
+} GameResult;
+
+// tournament:
+typedef void (*ThreadRoutine)(void *arg);
+
+typedef struct thread // portable wrapper around pthreads / Win32 threads
+{
+    ThreadRoutine routine;
+    void *arg;
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+} Thread;
+
+typedef struct gameTask
+{
+    int pairing;    // difficulty1 * BOT_DIFFICULTIES + difficulty2
+    int games;      // number of games of this pairing to play
+    long firstGame; // index of the first of them, picks the game seeds
+} GameTask;
+
+typedef struct taskDeque // Chase-Lev deque, the owner pops at the bottom, thieves steal at the top
+{
+    GameTask *tasks;
+    atomic_long top;
+    atomic_long bottom;
+} TaskDeque;
+
+typedef struct pairingStats
+{
+    long games;
+    long wins[2];
+    long unfinished;
+    long turns;
+    long movesUsed[MOVES_COUNT];
+} PairingStats;
+
+typedef struct tournamentWorker
+{
+    int id;
+    int workerCount;
+    struct tournamentWorker *workers; // every worker of the tournament, to steal from
+    uint64_t seed;                    // tournament seed, every game derives its own from it
+    TaskDeque deque;
+    Arena arena; // reused by every game of the worker
+    ReplayWriter *replay; // <--record path>.<id>, NULL: not recorded
+    long steals;
+    PairingStats stats[BOT_DIFFICULTIES * BOT_DIFFICULTIES]; // per-thread accumulator, merged after join
+} TournamentWorker;
+
+#define SYMMETRIES 8                  // rotations and reflections of the grid
+#define TABLEBASE_MAGIC "BSENDTBL"
+#define TABLEBASE_VERSION 1
+#define TABLEBASE_HEADER 16           // magic, version, limit, slot bits, 1 reserved, entries (4 bytes)
+#define TABLEBASE_SLOT 16             // key (8), expected shots in 1/1000 (4), move, row + 1, col + 1, 1 reserved
+#define TABLEBASE_CONFIGURATIONS 16   // --build-tablebase defaults: solved offline, past the solver's threshold
+#define TABLEBASE_NODES 1000000
+#define TABLEBASE_WORKER_BITS 16      // positions a generator thread can hold: 2^16 slots, at most half used, more is fatal
+#define TABLEBASE_UNSOLVED 255        // met but over budget: not solved again, not written
+
+typedef struct tablebase // moves solved offline, the file mapped read-only; the opening book is one too
+{
+    MappedFile map;
+    int limit;          // endgames: most configurations, opening book: fewest shots it does not cover; 0: none loaded
+    int bits;           // 2^bits slots
+    long entries;
+} Tablebase;
+
+typedef struct tablebaseEntry
+{
+    uint64_t key;       // canonical, see canonicalEndgameKey(); 0: empty slot
+    uint32_t expected;  // shots left, in 1/1000; opening book: chance of a hit, in 1/1000000
+    unsigned char move; // in the canonical orientation, TABLEBASE_UNSOLVED
+    signed char row;
+    signed char col;
+    long met;           // generator only: game * MAX_HEADLESS_TURNS + turn the position was first met in
+} TablebaseEntry;
+
+typedef struct tablebaseWorker // one generator thread: its share of the games and what it solved
+{
+    int id;
+    int workerCount;
+    long games;
+    uint64_t seed;
+    EndgameConfig config;  // the generator's, far above a move's
+    Arena arena;           // the games' bots
+    EndgameSolver *solver; // the generator's own, the bots' solvers play the games
+    long positions;        // endgame positions met
+    long solved;
+    long count;            // entries used
+    TablebaseEntry entries[1 << TABLEBASE_WORKER_BITS];
+} TablebaseWorker;
+
+#define OPENING_MAGIC "BSOPENBK"   // a tablebase file: key, expected shots in 1/1000, 0, row + 1, col + 1 per slot
+#define OPENING_DEPTH 12           // --build-opening-book defaults
+#define OPENING_ROLLOUTS 5000
+#define OPENING_HUMAN 50           // percent of opponents who place like the human model
+#define OPENING_ATTEMPTS (1 << 20) // draws for one fleet before the misses count as leaving no room
+
+typedef struct openingWorker // one builder thread: its share of the rollouts behind one book move
+{
+    int id;
+    int workerCount;
+    Bitboard misses;              // the book so far
+    MonteCarloEvidence *evidence; // placements that avoid them, shared and read-only
+    int *candidates;              // cells worth trying, one of each set the misses' symmetries make alike
+    int candidateCount;
+    uint64_t seed;                // of the book move
+    long rollouts;
+    int human;                    // percent
+    Arena arena;                  // the rollouts' bots
+    long shots[GRID_SIZE * GRID_SIZE]; // of every rollout of each candidate, summed
+    long hits[GRID_SIZE * GRID_SIZE];  // rollouts whose first shot hit
+    int exhausted;                     // a fleet took OPENING_ATTEMPTS draws, its rollouts were not played
+} OpeningWorker;
+
+// bot move latency, log-linear buckets in the style of HdrHistogram: exact below
+// 2^(LATENCY_SUB_BITS + 1) ns, then 2^LATENCY_SUB_BITS buckets per power of two (about 3% wide)
+#define LATENCY_SUB_BITS 5
+#define LATENCY_MAX_BITS 40 // about 18 minutes, longer moves land in the last bucket
+#define LATENCY_BUCKETS ((LATENCY_MAX_BITS + 1 - LATENCY_SUB_BITS) << LATENCY_SUB_BITS)
+
+typedef struct latencyHistogram
+{
+    uint64_t count;
+    uint64_t max; // ns, exact
+    uint64_t buckets[LATENCY_BUCKETS];
+} LatencyHistogram;
+
+// benchmarks:
+typedef struct benchPosition // a bot and its opponent part-way through a game, self-contained
+{
+    Player players[2]; // 0: the bot being measured, 1: its opponent; pointers lead into the arrays below
+    Ship ships[2][SHIPS_COUNT];
+    Move moves[2][MOVES_COUNT];
+    CellSet lists[2][4]; // botsShipsCoord, botHitList, radaredList, foundShips
+    DensityTracker tracker;
+} BenchPosition;
+
 // for the cells of the grid:
 enum cellStates
 {
@@ -65,33 +661,113 @@ enum cellStates
     carrier = 5,
 };
 
+// bot difficulty levels:
+enum botDifficulty
+{
+    easyBot = 0,    // targets meaningfully half of the time
+    mediumBot = 1,  // 75% of the time
+    hardBot = 2,    // always
+    densityBot = 3, // fires where most legal placements of the remaining ships overlap
+    monteCarloBot = 4, // fires where most sampled fleets consistent with the evidence overlap
+};
+
 // FUNCTIONS:
 
 int chooseMode();
 
-Player createPlayer();
+int chooseDifficulty(); // asks until it gets one of the bot difficulties
+
+Player createPlayer(Arena *arena); // arena: NULL for the heap
 
-Player createBotPlayer(int difficulty);
+Player createBotPlayer(int difficulty, Arena *arena);
 
-Ship *createShips();
+Ship *createShips(Arena *arena);
 
-Move *createMoves();
+Move *createMoves(Arena *arena);
 
-Cell *createCell(int row, int col);
+CellSet *createCellSet(Arena *arena);
 
-CellList *createList();
+// memory:
+Arena createArena(size_t capacity);
 
-void addCell(Cell **head, int row, int col);
+void arenaReset(Arena *arena);
 
-void removeCell(Cell **head, int row, int col);
+void freeArena(Arena *arena);
 
-int inList(Cell *head, int row, int col);
+void *allocate(Arena *arena, size_t size); // from the arena, or the heap if arena is NULL
+
+void countAllocation(); // every heap allocation goes through here
+
+void cellSetAdd(CellSet *set, int row, int col); // at the front, unless already in the set
+
+void cellSetRemove(CellSet *set, int row, int col);
+
+int cellSetContains(CellSet *set, int row, int col);
+
+int cellSetPopFront(CellSet *set, int *row, int *col); // 0 if the set is empty
+
+int cellSetGet(CellSet *set, int i); // i-th cell from the front, as row * GRID_SIZE + col
 
 // grid:
-int **createGrid();
+void clearBoard(Board *board);
+
+int cellState(Board *board, int row, int col); // enum cellStates value of a cell
+
+int isDiscovered(Board *board, int row, int col); // hit or miss
+
+void placeShipCells(Player *player, Bitboard cells, int shipSize);
 
 void displayGrid(Player *player);
 
+// bitboards:
+Bitboard bbFromBits(uint64_t bits);
+
+Bitboard bbShiftLeft(Bitboard b, int n);
+
+Bitboard bbCell(int row, int col);
+
+Bitboard bbRow(int row);
+
+Bitboard bbColumn(int col);
+
+Bitboard bbSquare(int row, int col); // 2x2 area with the given top-left cell
+
+Bitboard bbShip(int shipSize, int row, int col, int isVertical);
+
+Bitboard bbAnd(Bitboard a, Bitboard b);
+
+Bitboard bbOr(Bitboard a, Bitboard b);
+
+Bitboard bbAndNot(Bitboard a, Bitboard b); // a & ~b
+
+Bitboard bbXor(Bitboard a, Bitboard b);
+
+Bitboard bbShiftRight(Bitboard b, int n);
+
+Bitboard bbFull(); // every cell of the grid
+
+Bitboard bbLowCells(int n); // cells 0..n-1
+
+Bitboard bbLeftColumns(int n); // columns 0..n-1 of every row
+
+Bitboard bbNeighbours(Bitboard b); // cells next to b, up, down, left or right
+
+int bbTest(Bitboard b, int row, int col);
+
+int bbAny(Bitboard b);
+
+int bbCount(Bitboard b);
+
+int bbPopFirst(Bitboard *b); // removes the lowest cell and returns its index (row * GRID_SIZE + col)
+
+int bbNth(Bitboard b, int n); // index of the n-th lowest cell, n < bbCount(b)
+
+int popcount64(uint64_t x);
+
+int lowestBit64(uint64_t x);
+
+int highestBit64(uint64_t x);
+
 // ship placement:
 void placeShips(Player *player);
 
@@ -99,10 +775,25 @@ void placeShip(Player *player, int shipSize);
 
 int canPlaceShip(Player *player, int shipSize, int row, int col, char orientation);
 
-void botPlaceShip(Player *player, int shipSize);
+void botPlaceFleet(Player *player);
+
+void placeFleet(Player *player, Fleet *fleet); // a bot's, ships and botsShipsCoord
 
 int botShipOverlap(Player *player, int shipSize, int row, int col, int isVertical);
 
+void buildPlacementTable();
+
+int placementIndex(int shipSize, int row, int col, int isVertical); // inside the grid only
+
+// fleet sampling:
+int sampleFleet(Rng *rng, Fleet *fleet); // returns the number of attempts it took
+
+long sampleFleets(Rng *rng, Fleet *fleets, long count); // returns the total attempts
+
+Bitboard fleetMask(Fleet *fleet);
+
+int runFleetBenchmark(int argc, char *argv[]);
+
 char *getShipName(int i); // i: 2->5
 
 void clearInputBuffer();
@@ -127,21 +818,50 @@ int fire(Player *player, Player *opponent, int decision); // modified for bot
 
 int radarSweep(Player *player, Player *opponent); // modified for bot
 
+int resolveMove(Player *player, Player *opponent, int move, int row, int col); // see its definition
+
+int strike(Player *player, Player *opponent, Bitboard target); // shared by fire, artillery and torpedo
+
+int hitShip(Player *opponent, int cell); // a new hit on a ship cell, returns the ship it sinks or -1
+
 int smokeScreen(Player *player, Player *opponent); // modified for bot
 
 int artillery(Player *player, Player *opponent, int decision); // modified for bot
 
 int torpedo(Player *player, Player *opponent, int decision); // modified for bot
 
-int randomCoordinate(int upperBound);
+int randomCoordinate(Rng *rng, int upperBound);
+
+// make/unmake:
+int doMove(Player *player, Player *opponent, int move, int row, int col, UndoStack *stack); // returns the outcome
+
+void undoMove(Player *player, Player *opponent, UndoStack *stack); // the last doMove() of this player
+
+void cellSetTruncate(CellSet *set, int count); // drops the newest cells down to count
+
+// events:
+void emitEvent(Player *player, Player *opponent, int type, int move, int row, int col, int ship, int count);
+
+void consoleEvents(GameEvent *event, void *context); // the console front end's subscriber
+
+// random numbers:
+uint64_t splitMix64(uint64_t *state);
+
+void rngSeed(Rng *rng, uint64_t seed);
+
+uint64_t rngNext(Rng *rng);
+
+uint32_t rngBounded(Rng *rng, uint32_t bound);
+
+uint64_t gameSeed(uint64_t tournamentSeed, int pairing, long game);
 
 int checkAvailable(Player *player, int move);
 
 int botCheckAvailable(Player *player, int moveChosen);
 
-void chooseTopLeftMeaningfully(Cell *head1, Cell *head2, int *row, int *col);
+void chooseTopLeftMeaningfully(CellSet *cells, Bitboard skip, int *row, int *col);
 
-void chooseTopLeftMeaningfullyHelper(Cell *current, int *row, int *col);
+void chooseTopLeftMeaningfullyHelper(int cellRow, int cellCol, int *row, int *col);
 
 int validTopLeftCoordinate(int row, int col);
 
@@ -151,1524 +871,6482 @@ void updateMoves(Player *opponent, Player *player);
 
 void checkOneRoundMoves(Player *player, int move);
 
-int strcmpIgnoreNull(char *str1, char *str2);
 
 void freeAll(Player *player);
 
-void freeList(CellList *list);
+void freeCellSet(CellSet *set);
 
-// tracking difficulty level
-int mode;
+// density bot:
+void updateSunkKnowledge(Player *bot, Player *opponent);
 
-int main()
-{
+DensityTracker *createDensityTracker(Arena *arena);
 
-    /*-------------------------------------------------Game Setup and Initialization-------------------------------------------------------*/
+void densitySync(Player *bot, Player *opponent);
 
-    srand(time(NULL)); // seed the random number generator with current time
+void invalidateCell(DensityTracker *tracker, Player *opponent, int cell);
 
-    // player chooses: player vs player, OR player vs bot
+void invalidatePlacement(DensityTracker *tracker, int k, int p);
 
-    Player player1 = createPlayer();
-    // if bot, player2 is a bot
-    Player player2;
+int densityBest(DensityTracker *tracker, Rng *rng);
 
-    // read game mode:
+void densityMap(Player *bot, Player *opponent, int density[]);
 
-    mode = chooseMode();
-    printf("\n");
+int targetDensity(Player *bot, Player *opponent, Bitboard unresolved, int density[]);
 
-    // read players names:
-    // Player1
-    printf("Please enter your names!\nPlayer1: ");
-    scanf(" %99s", player1.name, 100);
-    // Player2 :Bot or Human?
-    printf("Player vs Bot (1) OR Player vs Player (0): ");
-    int isBot;
-    scanf("%d", &isBot);
+void densityBestCell(Player *bot, Player *opponent, int *row, int *col);
 
-    if (isBot)
-    {
-        printf("Choose bot difficulty (0: Easy, 1: Medium, 2: Hard): ");
-        int botDifficulty;
-        scanf("%d", &botDifficulty);
-        player2 = createBotPlayer(botDifficulty);
-    }
-    else
-    {
-        player2 = createPlayer();
-        printf("Player2: ");
-        scanf(" %99s", player2.name, 100);
-    }
+void densityBestSquare(Player *bot, Player *opponent, int *row, int *col);
 
-    // display grids:
-    printf("%s: \n", player1.name);
-    displayGrid(&player1);
-    printf("\n");
-    printf("%s: \n", player2.name);
-    displayGrid(&player2);
+void densityBestLine(Player *bot, Player *opponent, int *row, int *col);
 
-    printf("\n");
+int densityPickCell(int density[], Bitboard discovered, Rng *rng); // highest undiscovered cell, -1 if none
 
-    // randomly choose starting player:
-    int i = rand() % 2;
-    Player *startingPlayer;
-    Player *otherPlayer;
-    if (i == 0)
-    {
-        startingPlayer = &player1;
-        otherPlayer = &player2;
-    }
-    else
-    {
-        startingPlayer = &player2;
-        otherPlayer = &player1;
-    }
+int densityPickSquare(int density[], Rng *rng, int *row, int *col); // returns the sum of its cells
 
-    // place ships:
-    printf("Placing your ships: \n");
-    printf("\n");
-    getchar();
-    printf("%s will start! Press enter to proceed.\n", startingPlayer->name);
-    printf("\n");
-    getchar();
-    system("cls");
-    placeShips(startingPlayer);
-    printf("Now is %s's turn! Press enter to proceed.\n", otherPlayer->name);
-    printf("\n");
-    getchar();
-    system("cls");
-    placeShips(otherPlayer);
+int densityPickLine(int density[], Rng *rng, int *row, int *col); // the other coordinate is -1
 
-    /*-----------------------------------------------------------Game Play-----------------------------------------------------------------*/
+// options:
+int parseOptions(int argc, char *argv[]); // removes the options any command takes, returns the new argc
 
-    printf("Now we will proceed with the game :) \n");
-    printf("\n");
+// monte carlo bot:
 
-    // game loop:
-    while (1)
-    {
-        takeTurn(startingPlayer, otherPlayer);
-        if (gameOver(otherPlayer, startingPlayer))
-            break;
-        takeTurn(otherPlayer, startingPlayer);
-        if (gameOver(startingPlayer, otherPlayer))
-            break;
-    }
+int smokeLaid(Player *bot, Player *opponent); // whether the opponent has laid a smoke screen, from public facts only
 
-    // free memory allocated for the players:
-    freeAll(&player1);
-    freeAll(&player2);
+int gatherEvidence(Player *bot, Player *opponent, MonteCarloEvidence *evidence); // 0 if nothing fits
 
-    return 0;
-}
+double sampleConsistentFleet(MonteCarloEvidence *evidence, Rng *rng, Bitboard *fleet); // its weight, 0 if rejected
 
-/*-------------------------------------------------Game Setup and Initialization-------------------------------------------------------*/
-int chooseMode()
-{
-    char input[10]; // Buffer for input
-    int mode;
+void monteCarloWorkerMain(void *arg);
 
-    printf("Welcome to MAN.BattleShip!\n\nPlease choose the tracking difficulty level by entering '0' for easy and '1' for hard: ");
+long monteCarloMap(Player *bot, Player *opponent, Rng *rng, int density[]); // returns the fleets sampled, 0 if none
 
-    while (1) // Loop until valid input is received
-    {
-        // Read the input
-        scanf("%s", input); // Read input as a string
+int monteCarloTarget(Player *bot, Player *opponent, int move, int *row, int *col); // 0 if no fleet fits the evidence
 
-        // Validate if the input is a number
-        int validInput = 1; // Flag to check if input is valid
-        for (size_t i = 0; i < strlen(input); i++)
-        {
-            if (!isdigit(input[i])) // Check if each character is a digit
-            {
-                validInput = 0; // Not a valid number
-                break;
-            }
-        }
+void monteCarloBestTarget(Player *bot, Player *opponent, int move, int *row, int *col); // the density bot's if none fits
 
-        // If the input is valid and a number
-        if (validInput)
-        {
-            mode = atoi(input); // Convert string to integer
+// transposition table:
+void buildZobristKeys();
 
-            // Check if the move is either 0 or 1
-            if (mode == 0 || mode == 1)
-            {
-                return mode; // Valid input received, return the difficulty level
-            }
-            else
-            {
-                printf("\nInvalid input! Please choose either '0' for easy or '1' for hard : ");
-            }
-        }
-        else
-        {
-            printf("\nInvalid input! Please enter a valid number (0 or 1): ");
-        }
-    }
-}
-Player createPlayer()
-{
-    Player player;
-    player.grid = createGrid();
-    player.shipsSunk = 0;
-    player.ships = createShips();
-    player.moves = createMoves();
-    player.smokedCells = createList();
-    player.isBot = 0;       // Default to human player
-    player.difficulty = -1; // Not applicable for human player
+uint64_t observationKey(Player *bot, Player *opponent); // the same knowledge hashes the same, in any order
+
+int transpositionProbe(uint64_t key, uint64_t *data); // 1 on a hit
+
+void transpositionStore(uint64_t key, uint64_t data);
+
+// endgame solver:
+EndgameSolver *createEndgameSolver(Arena *arena);
+
+int endgameMove(Player *bot, Player *opponent, int *move, int *row, int *col); // 0 if the bot should choose as usual
+
+int endgameEnumerate(EndgameSolver *solver, Player *bot, Player *opponent, int threshold); // -1 if more fit, or too many ships are afloat
+
+uint32_t endgameCompletions(MonteCarloEvidence *evidence, int sunk[], int n, Bitboard occupied); // ways the sunk ships can lie
+
+int endgameSolve(EndgameSolver *solver, Player *bot, Player *opponent, EndgameConfig *config, int *move, int *row, int *col); // 0 if over budget
+
+double endgameSearch(EndgameSolver *solver, uint64_t subset[], Bitboard hits, int counts[], int shipsSunk, double bound, int best[3]);
+
+double endgameAction(EndgameSolver *solver, uint64_t subset[], double total, Bitboard hits, int counts[], int shipsSunk,
+                     int move, Bitboard target, double bound); // expected shots, or at least bound
+
+int endgameLowerBound(int cells, int afloat, int counts[], int shipsSunk); // shots at least
+
+int endgameCounts(int counts[], int move, int sinks, int shipsSunk, int next[]); // returns the ships sunk after it
+
+int runEndgameBenchmark(uint64_t seed, long positions); // JSON lines, see runBenchmark()
+
+// tablebase:
+void buildSymmetries();
+
+Bitboard bbTransform(Bitboard b, int symmetry);
+
+Bitboard moveTarget(int move, int row, int col); // the cells a move covers, torpedo: row or col is -1
+
+void transformMove(int move, int *row, int *col, int symmetry);
+
+uint64_t endgameKey(EndgameSolver *solver, Bitboard hits, int counts[], int symmetry);
+
+uint64_t canonicalEndgameKey(EndgameSolver *solver, Bitboard hits, int counts[], int *symmetry); // the lowest key of the 8
+
+int openTablebase(Tablebase *table, const char *path, const char *magic); // 0 if the file is missing or not this kind of table
+
+void closeTablebase(Tablebase *table);
+
+const unsigned char *tablebaseFind(Tablebase *table, uint64_t key); // the key's slot, NULL if it is not in the file
+
+int writeTablebase(const char *path, const char *magic, int limit, TablebaseEntry entries[], long count); // 0 on failure
+
+int tablebaseProbe(Tablebase *table, EndgameSolver *solver, Bitboard hits, int counts[], int *move, int *row, int *col); // 1 on a hit
+
+TablebaseEntry *tablebaseSlot(TablebaseEntry entries[], int bits, uint64_t key); // the key's slot, or the empty one it goes to
+
+void tablebaseSolve(TablebaseWorker *worker, Player *player, Player *opponent, long met); // met: when, see TablebaseEntry
+
+void tablebaseWorkerMain(void *arg);
+
+int compareTablebaseEntries(const void *a, const void *b); // by key, for qsort()
+
+int runBuildTablebase(int argc, char *argv[]);
+
+// opening book:
+uint64_t openingKey(Bitboard misses, int symmetry);
+
+uint64_t canonicalOpeningKey(Bitboard misses, int *symmetry); // the lowest key of the 8
+
+int openingMove(Tablebase *book, Board *board, int *row, int *col); // 1 on a hit: no hits yet and a book position
+
+int sampleOpeningFleet(MonteCarloEvidence *evidence, Rng *rng, Fleet *fleet); // 0 on overlap, 2 if no ships touch, else 1
+
+int openingRollout(Arena *arena, Fleet *fleet, Bitboard misses, int cell, uint64_t seed); // the Hard bot's turns to sink fleet
+
+void openingWorkerMain(void *arg);
+
+int runBuildOpeningBook(int argc, char *argv[]);
+
+// packed state:
+void packPlayer(PackedPlayer *packed, Player *player);
+
+void unpackPlayer(Player *player, PackedPlayer *packed); // into a player made by createPlayer()
+
+void packGame(PackedGame *game, Player *players[2], Rng *rng, int current, int turns);
+
+void unpackGame(Player *players[2], Rng *rng, PackedGame *game);
+
+Bitboard packedShipMask(PackedPlayer *player, int k);
+
+int packedStrike(PackedPlayer *opponent, Bitboard target); // strike() on packed state, returns the new hits
+
+int packedRadar(PackedPlayer *opponent, int row, int col); // 1 if the sweep finds a ship
+
+void packedSmoke(PackedPlayer *player, int row, int col);
+
+void packedUpdateSinks(PackedPlayer *opponent, PackedPlayer *player); // updateGameState() on packed state
+
+// replay log:
+ReplayWriter *openReplayWriter(const char *path); // NULL if the file cannot be created
+
+int closeReplayWriter(ReplayWriter *writer); // 0 if any write failed
+
+void replayBeginGame(ReplayWriter *writer, Player *players[2], uint64_t seed, int first); // after placeShips()
+
+void replayEndGame(ReplayWriter *writer, int winner);
+
+void replayEvents(GameEvent *event, void *context);
+
+void replayPut(ReplayWriter *writer, const void *bytes, size_t count);
+
+void replayPutVarint(ReplayWriter *writer, uint64_t value);
+
+int mapFile(MappedFile *map, const char *path, int access); // 0 if the file is missing or empty
+
+void unmapFile(MappedFile *map);
+
+int openReplay(ReplayReader *reader, const char *path); // 0 if the file is missing or not a replay log
+
+void closeReplay(ReplayReader *reader);
+
+int replayNextGame(ReplayReader *reader, ReplayGame *game); // 0 at the end of the file or on damage
+
+int replayNextTurn(ReplayReader *reader, ReplayGame *game, ReplayTurn *turn); // 0 at the end of the game
+
+int replayGetVarint(ReplayReader *reader, uint64_t *value);
+
+int runReplayStats(int argc, char *argv[]);
+
+ReplayEngine *createReplayEngine();
+
+void freeReplayEngine(ReplayEngine *engine);
+
+int replayLoad(ReplayEngine *engine, ReplayReader *reader); // the next game of the log, 0 if there is none
+
+int replayApply(ReplayEngine *engine, ReplayTurn *turn); // 0 if the recorded outcome does not follow
+
+void replaySeek(ReplayEngine *engine, int turn); // the state after that many turns
+
+void printReplayBoard(Player *player);
+
+int runReplay(int argc, char *argv[]);
+
+int runReplayCheck(int argc, char *argv[]);
+
+// self-test:
+int runSelfTest(int argc, char *argv[]);
+
+long checkMakeUnmake(Player *players[2], int current, BenchPosition *snapshot, UndoStack *stack, Rng *rng, long *moves); // positions not restored
+
+int samePlayerState(Player *a, Player *b); // everything a move can change, bot lists included
+
+int sameCellSet(CellSet *a, CellSet *b);
+
+double endgameReference(EndgameSolver *solver, uint64_t subset, Bitboard hits, int counts[], int shipsSunk, long *nodes); // expected shots, no pruning; -1: over budget
+
+// batch engine:
+int randomStrike(Rng *rng, int torpedoes, int artilleries, Bitboard discovered, Bitboard *target); // returns the move
+
+GameResult playPackedGame(uint64_t seed); // one game at a time: the scalar reference of runBatch()
+
+GameResult playPlayerGame(uint64_t seed, Arena *arena); // the same game on Player state, through strike()
+
+void packedPlaceFleet(PackedPlayer *player, Rng *rng);
+
+void packFleet(PackedPlayer *player, Fleet *fleet); // a player before the first turn
+
+void runBatch(long games, uint64_t seed, GameResult results[]); // game g is played from gameSeed(seed, 0, g)
+
+void batchRefill(BatchEngine *engine, GameResult results[]);
+
+void batchLoadFleet(BatchSide *side, int lane, Fleet *fleet);
+
+void batchStep(BatchEngine *engine, GameResult results[]);
+
+void batchResolve(BatchSide *opponent, BatchSide *player, uint64_t targetLo[], uint64_t targetHi[]);
+
+const char *batchInstructionSet();
+
+// headless simulation:
+GameResult playHeadlessGame(int difficulty1, int difficulty2, uint64_t seed, Arena *arena, ReplayWriter *replay); // replay: NULL for none
+
+int runCommandLine(int argc, char *argv[]);
+
+void printUsage(char *program);
+
+int runSimulation(int argc, char *argv[]);
+
+// benchmarks:
+int runBenchmark(int argc, char *argv[]);
+
+void makeBenchPosition(BenchPosition *position, Rng *rng);
+
+void linkBenchPosition(BenchPosition *position); // points its players into its arrays
+
+void copyPlayerState(Player *to, Player *from); // keeps the allocations of to
+
+void benchKernel(int kernel, Player *bot, Player *opponent, UndoStack *stack);
+
+// latency:
+uint64_t nanoseconds();
+
+int latencyBucket(uint64_t ns);
+
+uint64_t latencyBucketLimit(int bucket); // highest latency that lands in the bucket
+
+void latencyRecord(int difficulty, int move, uint64_t ns);
+
+void latencyFlush(); // adds this thread's histograms to the total
+
+uint64_t latencyPercentile(LatencyHistogram *histogram, double percentile);
+
+void latencyReport();
+
+// instrumentation (INSTRUMENT builds only):
+#ifdef INSTRUMENT
+uint64_t readCycles();
+
+void probeRecord(int probe, uint64_t start);
+
+void instrumentFlush(); // adds this thread's table to the total
+
+void instrumentReport(); // prints the total to stderr
+#endif
+
+// tournament:
+char *difficultyName(int difficulty);
+
+int runTournament(int argc, char *argv[]);
+
+double playTournament(int threads, long gamesPerPairing, uint64_t seed, PairingStats *total, long *steals);
+
+void tournamentWorkerMain(void *arg);
+
+int popTask(TaskDeque *deque, GameTask *task);
+
+int stealTask(TaskDeque *deque, GameTask *task);
+
+void addGameResult(PairingStats *stats, GameResult *result);
+
+void mergePairingStats(PairingStats *into, PairingStats *from);
+
+void startThread(Thread *thread, ThreadRoutine routine, void *arg);
+
+void joinThread(Thread *thread);
+
+void runWorkers(int threads, ThreadRoutine routine, void *workers, size_t stride); // workers: an array, stride bytes apart
+
+int cpuCount();
+
+double wallSeconds();
+
+// tracking difficulty level
+int mode;
+
+// --record=<path>: headless games are written to this replay log, NULL: not recorded
+char *recordPath;
+
+// --tablebase=<path>: mapped by main() before any game, read-only and shared by every thread
+char *tablebasePath;
+Tablebase tablebase;
+
+// --opening-book=<path>: mapped like the tablebase, the Hard bot's first shots come from it
+char *openingBookPath;
+Tablebase openingBook;
+
+// cell of every cell under each symmetry, and the symmetry that undoes each; read-only once buildSymmetries() ran
+unsigned char symmetryCell[SYMMETRIES][GRID_SIZE * GRID_SIZE];
+int inverseSymmetry[SYMMETRIES];
+
+// ships an opponent must have lost before each move unlocks, see updateMoves()
+const int moveUnlockThresholds[MOVES_COUNT] = {0, 0, 1, 1, 3};
+
+// uses of each move a player starts with, -1: unlimited
+const int initialMoveCounts[MOVES_COUNT] = {-1, 3, 0, 0, 0};
+
+// heap allocations so far, games on an arena should not add any
+atomic_long heapAllocations;
+
+// ship geometry, read-only once buildPlacementTable() ran
+PlacementTable placements;
+
+// read-only once buildZobristKeys() ran
+ZobristKeys zobrist;
+
+// evaluated targets, shared by every thread of the process
+TranspositionEntry transpositionTable[1 << TRANSPOSITION_BITS];
+int transpositionEnabled = 1; // 0: every probe misses, for benchmarks that revisit positions
+
+#ifdef INSTRUMENT
+_Thread_local InstrumentTable instrumentLocal; // every thread counts on its own, see instrumentFlush()
+InstrumentTable instrumentTotal;
+atomic_flag instrumentLock = ATOMIC_FLAG_INIT;
+#endif
+
+// bot move latency histograms, only filled with --latency
+int recordLatency;
+_Thread_local LatencyHistogram latencyLocal[BOT_DIFFICULTIES][MOVES_COUNT];
+LatencyHistogram latencyTotal[BOT_DIFFICULTIES][MOVES_COUNT];
+atomic_flag latencyLock = ATOMIC_FLAG_INIT;
+
+// Monte Carlo bot budgets: time-boxed against a human, reproducible (fixed sample count) without one
+MonteCarloConfig interactiveMonteCarlo = {0, 40, 0};
+MonteCarloConfig headlessMonteCarlo = {1000, 0, 1};
+
+// and its endgame solver's, the same way
+EndgameConfig interactiveEndgame = {ENDGAME_THRESHOLD, 0, 200};
+EndgameConfig headlessEndgame = {ENDGAME_THRESHOLD, ENDGAME_NODES, 0};
+
+int main(int argc, char *argv[])
+{
+
+    /*-------------------------------------------------Game Setup and Initialization-------------------------------------------------------*/
+
+    buildPlacementTable(); // before any thread or bot needs it
+    buildZobristKeys();
+    buildSymmetries();
+    argc = parseOptions(argc, argv);
+    if (tablebasePath != NULL && !openTablebase(&tablebase, tablebasePath, TABLEBASE_MAGIC))
+    {
+        printf("Cannot read tablebase %s\n", tablebasePath);
+        return 1;
+    }
+    if (openingBookPath != NULL && !openTablebase(&openingBook, openingBookPath, OPENING_MAGIC))
+    {
+        printf("Cannot read opening book %s\n", openingBookPath);
+        return 1;
+    }
+
+    Rng rng;
+    rngSeed(&rng, (uint64_t)time(NULL)); // seed the random number generator with current time
+
+    // bot-vs-bot runs without a terminal, see printUsage()
+    if (argc > 1)
+    {
+        int status = runCommandLine(argc, argv);
+        if (recordLatency)
+            latencyReport();
+        INSTRUMENT_REPORT();
+        return status;
+    }
+
+    // player chooses: player vs player, OR player vs bot
+
+    Player player1 = createPlayer(NULL);
+    player1.rng = &rng;
+    // if bot, player2 is a bot
+    Player player2;
+
+    // read game mode:
+
+    mode = chooseMode();
+    printf("\n");
+
+    // read players names:
+    // Player1
+    printf("Please enter your names!\nPlayer1: ");
+    scanf(" %99s", player1.name, 100);
+    // Player2 :Bot or Human?
+    printf("Player vs Bot (1) OR Player vs Player (0): ");
+    int isBot;
+    scanf("%d", &isBot);
+
+    if (isBot)
+    {
+        player2 = createBotPlayer(chooseDifficulty(), NULL);
+    }
+    else
+    {
+        player2 = createPlayer(NULL);
+        printf("Player2: ");
+        scanf(" %99s", player2.name, 100);
+    }
+    player2.rng = &rng;
+
+    // the console reports everything both players do
+    EventSink console = {consoleEvents, NULL};
+    player1.events = &console;
+    player2.events = &console;
+
+    // display grids:
+    printf("%s: \n", player1.name);
+    displayGrid(&player1);
+    printf("\n");
+    printf("%s: \n", player2.name);
+    displayGrid(&player2);
+
+    printf("\n");
+
+    // randomly choose starting player:
+    int i = rngBounded(&rng, 2);
+    Player *startingPlayer;
+    Player *otherPlayer;
+    if (i == 0)
+    {
+        startingPlayer = &player1;
+        otherPlayer = &player2;
+    }
+    else
+    {
+        startingPlayer = &player2;
+        otherPlayer = &player1;
+    }
+
+    // place ships:
+    printf("Placing your ships: \n");
+    printf("\n");
+    getchar();
+    printf("%s will start! Press enter to proceed.\n", startingPlayer->name);
+    printf("\n");
+    getchar();
+    system("cls");
+    placeShips(startingPlayer);
+    printf("Now is %s's turn! Press enter to proceed.\n", otherPlayer->name);
+    printf("\n");
+    getchar();
+    system("cls");
+    placeShips(otherPlayer);
+
+    /*-----------------------------------------------------------Game Play-----------------------------------------------------------------*/
+
+    printf("Now we will proceed with the game :) \n");
+    printf("\n");
+
+    // game loop:
+    while (1)
+    {
+        takeTurn(startingPlayer, otherPlayer);
+        if (gameOver(otherPlayer, startingPlayer))
+            break;
+        takeTurn(otherPlayer, startingPlayer);
+        if (gameOver(startingPlayer, otherPlayer))
+            break;
+    }
+
+    // free memory allocated for the players:
+    freeAll(&player1);
+    freeAll(&player2);
+
+    if (recordLatency)
+        latencyReport();
+    INSTRUMENT_REPORT();
+    return 0;
+}
+
+/*-------------------------------------------------Game Setup and Initialization-------------------------------------------------------*/
+int chooseMode()
+{
+    char input[10]; // Buffer for input
+    int mode;
+
+    printf("Welcome to MAN.BattleShip!\n\nPlease choose the tracking difficulty level by entering '0' for easy and '1' for hard: ");
+
+    while (1) // Loop until valid input is received
+    {
+        // Read the input
+        scanf("%s", input); // Read input as a string
+
+        // Validate if the input is a number
+        int validInput = 1; // Flag to check if input is valid
+        for (size_t i = 0; i < strlen(input); i++)
+        {
+            if (!isdigit(input[i])) // Check if each character is a digit
+            {
+                validInput = 0; // Not a valid number
+                break;
+            }
+        }
+
+        // If the input is valid and a number
+        if (validInput)
+        {
+            mode = atoi(input); // Convert string to integer
+
+            // Check if the move is either 0 or 1
+            if (mode == 0 || mode == 1)
+            {
+                return mode; // Valid input received, return the difficulty level
+            }
+            else
+            {
+                printf("\nInvalid input! Please choose either '0' for easy or '1' for hard : ");
+            }
+        }
+        else
+        {
+            printf("\nInvalid input! Please enter a valid number (0 or 1): ");
+        }
+    }
+}
+
+int chooseDifficulty()
+{
+    char input[10];
+    printf("Choose bot difficulty (0: Easy, 1: Medium, 2: Hard, 3: Expert, 4: Master): ");
+    while (1) // Loop until valid input is received
+    {
+        if (scanf("%9s", input) != 1)
+            exit(1); // end of input: nothing left to ask
+        char *end;
+        long difficulty = strtol(input, &end, 10);
+        if (end != input && *end == '\0' && difficulty >= 0 && difficulty < BOT_DIFFICULTIES)
+        {
+            return (int)difficulty;
+        }
+        printf("\nInvalid input! Please choose a difficulty from 0 to %d: ", BOT_DIFFICULTIES - 1);
+    }
+}
+Player createPlayer(Arena *arena)
+{
+    Player player;
+    clearBoard(&player.board);
+    player.shipsSunk = 0;
+    player.sinking = 0;
+    player.arena = arena;
+    player.events = NULL;
+    player.ships = createShips(arena);
+    player.moves = createMoves(arena);
+    player.silent = 0;      // interactive game: talk to the console
+    player.lastMove = -1;
+    player.rng = NULL;
+    player.sunkCells = bbFromBits(0);
+    player.sunkSeen = 0;
+    player.densityTracker = NULL;
+    player.endgame = NULL;
+    player.openingBook = NULL;
+    player.isBot = 0;       // Default to human player
+    player.difficulty = -1; // Not applicable for human player
     return player;
 }
 
-Player createBotPlayer(int difficulty)
+Player createBotPlayer(int difficulty, Arena *arena)
+{
+    Player bot = createPlayer(arena);
+    strcpy(bot.name, "Bot");
+    bot.isBot = 1;               // Mark as bot
+    bot.difficulty = difficulty; // Set bot difficulty
+    // No need to allocate grid again since createPlayer() already does it
+    bot.botsShipsCoord = createCellSet(arena);
+    bot.botHitList = createCellSet(arena);
+    bot.radaredList = createCellSet(arena);
+    bot.foundShips = createCellSet(arena);
+    if (difficulty == densityBot || difficulty == monteCarloBot) // the Monte Carlo bot falls back on it
+    {
+        bot.densityTracker = createDensityTracker(arena); // nothing is known about the opponent yet
+    }
+    if (difficulty == monteCarloBot)
+    {
+        bot.endgame = createEndgameSolver(arena);
+    }
+    if (difficulty == hardBot && openingBook.limit > 0)
+    {
+        bot.openingBook = &openingBook;
+    }
+    return bot;
+}
+
+Ship *createShips(Arena *arena)
+{
+    Ship *ships = (Ship *)allocate(arena, sizeof(Ship) * SHIPS_COUNT);
+    for (int i = 2; i <= 5; i++)
+    {
+        strcpy(ships[i - 2].name, getShipName(i));
+        ships[i - 2].remainingHits = i;
+    }
+    return ships;
+}
+
+Move *createMoves(Arena *arena)
+{
+    Move *moves = (Move *)allocate(arena, sizeof(Move) * MOVES_COUNT);
+    const char *names[MOVES_COUNT] = {"FIRE", "RADAR SWEEP", "SMOKE SCREEN", "ARTILLERY", "TORPEDO"};
+
+    for (int i = 0; i < MOVES_COUNT; i++)
+    {
+        strcpy(moves[i].name, names[i]);
+        moves[i].countAvailable = initialMoveCounts[i];
+        moves[i].shipsSunkToUnlock = moveUnlockThresholds[i];
+    }
+    return moves;
+}
+
+CellSet *createCellSet(Arena *arena)
+{
+    CellSet *set = (CellSet *)allocate(arena, sizeof(CellSet));
+    set->members = bbFromBits(0);
+    set->count = 0;
+    return set;
+}
+
+Arena createArena(size_t capacity)
+{
+    Arena arena;
+    arena.memory = (unsigned char *)malloc(capacity);
+    countAllocation();
+    if (arena.memory == NULL)
+    {
+        printf("Failed to allocate needed memory\n");
+        exit(1);
+    }
+    arena.used = 0;
+    arena.capacity = capacity;
+    return arena;
+}
+
+void arenaReset(Arena *arena)
+{
+    arena->used = 0; // whatever was allocated from it is gone
+}
+
+void freeArena(Arena *arena)
+{
+    free(arena->memory);
+    arena->memory = NULL;
+    arena->capacity = 0;
+}
+
+void *allocate(Arena *arena, size_t size)
+{
+    if (arena == NULL)
+    {
+        void *memory = malloc(size);
+        countAllocation();
+        if (memory == NULL)
+        {
+            printf("Failed to allocate needed memory\n");
+            exit(1);
+        }
+        return memory;
+    }
+    if (arena->capacity - arena->used < ARENA_ROUND(size)) // sized for a whole game, see GAME_ARENA_BYTES
+    {
+        printf("Failed to allocate needed memory\n");
+        exit(1);
+    }
+    void *memory = arena->memory + arena->used;
+    arena->used += ARENA_ROUND(size);
+    return memory;
+}
+
+void countAllocation()
+{
+    atomic_fetch_add_explicit(&heapAllocations, 1, memory_order_relaxed);
+    COUNT(counterAllocations, 1);
+}
+
+void clearBoard(Board *board)
+{
+    memset(board, 0, sizeof(Board)); // every cell empty and undiscovered
+}
+
+int cellState(Board *board, int row, int col)
+{
+    if (bbTest(board->hits, row, col))
+        return hit;
+    if (bbTest(board->misses, row, col))
+        return miss;
+    if (board->shipAt[row * GRID_SIZE + col] > 0)
+        return board->shipAt[row * GRID_SIZE + col] + 1; // ship size
+    return empty;
+}
+
+int isDiscovered(Board *board, int row, int col)
+{
+    return bbTest(bbOr(board->hits, board->misses), row, col);
+}
+
+void placeShipCells(Player *player, Bitboard cells, int shipSize)
+{
+    player->board.shipMask[shipSize - 2] = bbOr(player->board.shipMask[shipSize - 2], cells);
+    player->board.ships = bbOr(player->board.ships, cells);
+    while (bbAny(cells))
+        player->board.shipAt[bbPopFirst(&cells)] = (unsigned char)(shipSize - 1);
+}
+
+void displayGrid(Player *player)
+{
+    printf("   A B C D E F G H I J\n");
+    for (int i = 0; i < GRID_SIZE; i++)
+    {
+        printf("%2d", i + 1);
+        for (int j = 0; j < GRID_SIZE; j++)
+        {
+            char c;
+            switch (cellState(&player->board, i, j))
+            {
+            case miss:
+                if (mode == 0) // easy mode, show miss*/
+                    c = 'o';
+               else // hard mode, don't show miss*/
+                    c = '~';
+               break;
+            case hit:
+                c = '*';
+              break;
+            default: // undiscovered: cell empty or has a ship (ships not displayed on grid)*/
+               c = '~';
+                break;
+            }
+            printf(" %c", c);
+        }
+        printf("\n");
+    }
+}
+
+void placeShips(Player *player)
+{
+    if (!(player->isBot))
+    {
+        // instructions:
+        printf("These are your ships and their sizes: \ncarrier, 5 cells\nbattleship, 4 cells\ndestroyer, 3 cells\nsubmarine, 2 cells\n");
+        printf("\n");
+        printf("Please provide the coordinates and orientation to place each ship on the grid (e.g. B3, Horizontal).\n");
+        printf("The coordinates indicate the starting position of the ship. Horizontal orientation moves from left to right, and vertical orientation moves from top to bottom.\n");
+        printf("Follow this exact format: \ncoordinates: ColumnRow  (CapitalLetter[A->J]Number[1->10]) (e.g. B3)\norientation: 'H' for horizontal, 'V' for vertical\n");
+        printf("\n");
+        printf("Your input:\n");
+    }
+
+    if (player->isBot)
+    {
+        botPlaceFleet(player); // all ships at once, uniform over every legal fleet
+    }
+    else
+    {
+        for (int shipSize = 5; shipSize > 1; shipSize--)
+        {
+            placeShip(player, shipSize);
+            getchar();
+        }
+    }
+
+    if (player->silent)
+        return;
+
+    printf("Done placing %s's ships! Press enter to proceed\n", player->name);
+
+    getchar();
+    system("cls");
+}
+
+void placeShip(Player *player, int shipSize)
+{
+    char *name = getShipName(shipSize);
+    int rw;
+    char cl, orientation;
+
+    // read position:
+    printf("\n(ship name: %s, ship size: %d)\n", name, shipSize);
+    printf("coordinates (e.g. B3): ");
+    scanf(" %c%d", &cl, &rw);
+    clearInputBuffer();
+    printf("orientation (H/V): ");
+    scanf(" %c", &orientation);
+    printf("\n");
+
+    // map input to coordinates on the grid with 0-based index:
+    int col = cl - 'A';
+    int row = rw - 1;
+
+    // validate coordinates, and place ship or try again:
+    if (canPlaceShip(player, shipSize, row, col, orientation)) // place this ship, then move on to the next
+    {
+        placeShipCells(player, placements.mask[shipSize - 2][placementIndex(shipSize, row, col, orientation == 'V')], shipSize);
+    }
+    else // try again with same ship
+    {
+        placeShip(player, shipSize);
+    }
+}
+
+int canPlaceShip(Player *player, int shipSize, int row, int col, char orientation)
+{
+    if (col < 0 || col > 9 || row < 0 || row > 9 || (orientation != 'H' && orientation != 'V'))
+    {
+        printf("Invalid input format! Please try again while following the specified input format directions:\n\n");
+        return 0;
+    }
+    else
+    {
+        if (orientation == 'H')
+        {
+            if (col + shipSize > 10)
+            {
+                printf("Error: chosen coordinates extend beyond the grid! Try again:\n");
+                return 0;
+            }
+            if (botShipOverlap(player, shipSize, row, col, 0))
+            {
+                printf("Error: chosen coordinates overlap with another ship! Try again:\n");
+                return 0;
+            }
+        }
+        else if (orientation == 'V')
+        {
+            if (row + shipSize > 10)
+            {
+                printf("Error: chosen coordinates extend beyond the grid! Try again:\n");
+                return 0;
+            }
+            if (botShipOverlap(player, shipSize, row, col, 1))
+            {
+                printf("Error: chosen coordinates overlap with another ship! Try again:\n");
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+void botPlaceFleet(Player *player)
+{
+    Fleet fleet;
+    sampleFleet(player->rng, &fleet);
+    placeFleet(player, &fleet);
+}
+
+void placeFleet(Player *player, Fleet *fleet)
+{
+    for (int k = SHIPS_COUNT - 1; k >= 0; k--) // carrier first, like a human places them
+    {
+        int p = fleet->placement[k];
+        placeShipCells(player, placements.mask[k][p], k + 2);
+        for (int i = 0; i < k + 2; i++)
+        {
+            int cell = placements.cells[k][p][i];
+            cellSetAdd(player->botsShipsCoord, cell / GRID_SIZE, cell % GRID_SIZE);
+        }
+    }
+}
+
+int botShipOverlap(Player *player, int shipSize, int row, int col, int isVertical)
+{
+    Bitboard cells = placements.mask[shipSize - 2][placementIndex(shipSize, row, col, isVertical)];
+    return bbAny(bbAnd(player->board.ships, cells));
+}
+
+// placements of each ship: horizontal ones row by row first, then the vertical ones
+void buildPlacementTable()
+{
+    memset(&placements, 0, sizeof(PlacementTable));
+    for (int k = 0; k < SHIPS_COUNT; k++)
+    {
+        int shipSize = k + 2;
+        for (int isVertical = 0; isVertical < 2; isVertical++)
+        {
+            for (int row = 0; row < (isVertical ? GRID_SIZE - shipSize + 1 : GRID_SIZE); row++)
+            {
+                for (int col = 0; col < (isVertical ? GRID_SIZE : GRID_SIZE - shipSize + 1); col++)
+                {
+                    int p = placements.count[k]++;
+                    placements.mask[k][p] = bbShip(shipSize, row, col, isVertical);
+                    for (int i = 0; i < shipSize; i++)
+                    {
+                        int cell = isVertical ? (row + i) * GRID_SIZE + col : row * GRID_SIZE + col + i;
+                        placements.cells[k][p][i] = (unsigned char)cell;
+                        placements.cover[k][cell][placements.coverCount[k][cell]++] = (unsigned char)p;
+                    }
+                }
+            }
+        }
+    }
+}
+
+int placementIndex(int shipSize, int row, int col, int isVertical)
+{
+    int perRow = GRID_SIZE - shipSize + 1; // horizontal placements in a row
+    if (!isVertical)
+        return row * perRow + col;
+    return GRID_SIZE * perRow + row * GRID_SIZE + col;
+}
+
+// exact uniform fleet: every ship independently uniform over its placements, the whole fleet
+// is redrawn on any overlap. Placing ships one by one with retries would favour fleets whose
+// first ships leave more room, and gets slower the more crowded the board is.
+int sampleFleet(Rng *rng, Fleet *fleet)
+{
+    int attempts = 0;
+    while (1)
+    {
+        attempts++;
+        COUNT(counterFleetAttempts, 1);
+        Bitboard occupied = bbFromBits(0);
+        int k = SHIPS_COUNT - 1; // largest ship first: overlaps show up earliest
+        for (; k >= 0; k--)
+        {
+            int p = rngBounded(rng, placements.count[k]);
+            if (bbAny(bbAnd(occupied, placements.mask[k][p])))
+                break;
+            occupied = bbOr(occupied, placements.mask[k][p]);
+            fleet->placement[k] = (unsigned char)p;
+        }
+        if (k < 0)
+            return attempts;
+    }
+}
+
+long sampleFleets(Rng *rng, Fleet *fleets, long count)
+{
+    long attempts = 0;
+    for (long i = 0; i < count; i++)
+        attempts += sampleFleet(rng, &fleets[i]);
+    return attempts;
+}
+
+Bitboard fleetMask(Fleet *fleet)
+{
+    Bitboard mask = bbFromBits(0);
+    for (int k = 0; k < SHIPS_COUNT; k++)
+        mask = bbOr(mask, placements.mask[k][fleet->placement[k]]);
+    return mask;
+}
+
+// battleship --sample-fleets <count> [seed]
+int runFleetBenchmark(int argc, char *argv[])
+{
+    long count = atol(argv[2]);
+    uint64_t seed = argc > 3 ? strtoull(argv[3], NULL, 10) : (uint64_t)time(NULL);
+    long batch = count < (1L << 20) ? count : (1L << 20);
+    if (count <= 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    Fleet *fleets = (Fleet *)malloc(sizeof(Fleet) * batch);
+    countAllocation();
+    if (fleets == NULL)
+    {
+        printf("Failed to allocate needed memory\n");
+        exit(1);
+    }
+    Rng rng;
+    rngSeed(&rng, seed);
+
+    long attempts = 0;
+    double start = wallSeconds();
+    for (long done = 0; done < count; done += batch)
+    {
+        long n = count - done < batch ? count - done : batch;
+        attempts += sampleFleets(&rng, fleets, n);
+    }
+    double seconds = wallSeconds() - start;
+
+    printf("seed: %llu\n", (unsigned long long)seed);
+    printf("fleets: %ld, %d bytes each, %.3f attempts per fleet\n", count, (int)sizeof(Fleet), (double)attempts / count);
+    printf("time: %.3f s, %.0f fleets/sec\n", seconds, count / seconds);
+    free(fleets);
+    return 0;
+}
+
+char *getShipName(int i)
+{
+    char *name;
+    switch (i)
+    {
+    case 5:
+        name = "carrier";
+        break;
+    case 4:
+        name = "battleship";
+        break;
+    case 3:
+        name = "destroyer";
+        break;
+    case 2:
+        name = "submarine";
+        break;
+    }
+    return name;
+}
+
+void clearInputBuffer()
+{
+    int c;
+    while ((c = getchar()) != '\n' && c != EOF)
+        ;
+}
+/*-----------------------------------------------------------Game Play-----------------------------------------------------------------*/
+
+void takeTurn(Player *player, Player *opponent)
+{
+    if (player->isBot)
+    {
+        // Bot's turn logic
+        printf("%s taking turn...\n", player->name);
+    }
+    else
+    {
+        printf("%s's Turn! Press enter to proceed \n", player->name);
+        getchar();
+        system("cls");
+
+        printf("%s's current grid: \n\n", opponent->name);
+        displayGrid(opponent);
+
+        printf("\nAvailable moves: \n\n");
+        displayAvailableMoves(player, opponent);
+    }
+    if (makeMove(player, opponent))
+    { // move complete, player did not lose their turn
+        updateGameState(opponent, player);
+        printf("\n%s's updated grid: \n\n", opponent->name);
+        displayGrid(opponent);
+    }
+    else
+    {
+
+        getchar();
+    }
+
+    getchar();
+    printf("\nPress enter to proceed!\n");
+    getchar();
+    system("cls");
+}
+
+void displayAvailableMoves(Player *player, Player *opponent)
+{
+    printf("FIRE, targets a cell of the opponent's grid.\n");
+    printf("Input format: identifier: '0', coordinate (e.g. B3)\n\n");
+    for (int i = 1; i < MOVES_COUNT; i++)
+    {
+        if (player->moves[i].countAvailable > 0)
+        {
+            if (i == 1)
+            {
+                printf("RADAR SWEEP, reveals whether there are any opponent ships in a specified 2x2 area of their grid without showing exact locations of ships.\n");
+                printf("Input format: identifier: '1', top-left coordinate (e.g. B3, to target B3, B4, C3, C4)\n\n");
+            }
+            if (i == 2)
+            {
+                printf("SMOKE SCREEN, obscures a 2x2 area of your grid by hiding it from radar sweeps.\n");
+                printf("Input format: identifier: '2', top-left coordinate (e.g. B3, to target B3, B4, C3, C4)\n\n");
+            }
+            if (i == 3)
+            {
+                printf("ARTILLERY, an attack move that works similarly to FIRE but targets a 2x2 area.\n");
+                printf("Input format: identifier: '3', top-left coordinate (e.g. B3, to target B3, B4, C3, C4)\n\n");
+            }
+            if (i == 4)
+            {
+                printf("TORPEDO, powerful attack that targets an entire row or column.\n");
+                printf("Input format: identifier: '4', either row number (1->10) or column letter (A->J).\n\n");
+            }
+        }
+    }
+    printf("\n");
+}
+
+int makeMove(Player *player, Player *opponent) // handle inputs that are not numbers
+{
+    PROBE_BEGIN(probeMakeMove);
+    // Bot logic
+    if (player->isBot)
+    {
+        int moveChosen = -1; // Move chosen by the bot
+        int result = 0;
+        uint64_t start = recordLatency ? nanoseconds() : 0; // decision and move together
+        int row, col;
+
+        if (endgameMove(player, opponent, &moveChosen, &row, &col)) // the Master bot plays the end exactly
+        {
+            PROBE_BEGIN(probeFire + moveChosen); // counted like the move functions, the search stays in makeMove's
+            resolveMove(player, opponent, moveChosen, row, col);
+            PROBE_END(probeFire + moveChosen);
+            result = 1;
+        }
+        else
+        {
+            if (botCheckAvailable(player, 4)) // choose torpedo whenever it's available
+            {
+                moveChosen = 4;
+            }
+            else if (botCheckAvailable(player, 3)) // else, choose artillery whenever available
+            {
+                moveChosen = 3;
+            }
+            else if (botCheckAvailable(player, 2)) // else, choose smoke smoke screen whenever available
+            {
+                moveChosen = 2;
+            }
+
+            else
+            {
+                do
+                {
+                    int r = rngBounded(player->rng, 101);
+                    if (r >= 80 && player->difficulty != densityBot) // the density map already says more than a sweep
+                    {
+                        moveChosen = 1; // choose radar sweep
+                    }
+                    else
+                    {
+                        moveChosen = 0; // choose fire
+                    }
+                } while (!botCheckAvailable(player, moveChosen)); // ensure the move is valid, i.e. we did not exhaust all 3 radar sweeps available
+            }
+        
+            int decision = decideTarget(player); // 1 if target meaningfully, 0 if target randomly
+
+            // Execute the chosen move for Easy Bot
+            switch (moveChosen)
+            {
+            case 0: // FIRE logic for Easy Bot
+                result = fire(player, opponent, decision); // Perform the FIRE move
+                break;
+
+            case 1: // RADAR SWEEP (Placeholder for Easy Bot Logic)
+                result = radarSweep(player, opponent);
+                break;
+
+            case 2: // SMOKE SCREEN (Placeholder for Easy Bot Logic)
+                result = smokeScreen(player, opponent);
+                break;
+
+            case 3: // ARTILLERY (Placeholder for Easy Bot Logic)
+                result = artillery(player, opponent, decision);
+                break;
+
+            case 4: // TORPEDO (Placeholder for Easy Bot Logic)
+                result = torpedo(player, opponent, decision);
+                break;
+
+            default:
+                if (!player->silent)
+                    printf("Bot failed to make a valid move.\n");
+                PROBE_RETURN(probeMakeMove, 0); // Skip turn if no valid move is made
+            }
+        }
+
+        if (result && player->moves[moveChosen].countAvailable > 0) // FIRE (-1) is unlimited
+        {
+            player->moves[moveChosen].countAvailable--; // Decrement move availability
+        }
+        if (result)
+        {
+            player->lastMove = moveChosen;
+        }
+        if (recordLatency)
+        {
+            latencyRecord(player->difficulty, moveChosen, nanoseconds() - start);
+        }
+
+        PROBE_RETURN(probeMakeMove, result); // Return whether the bot successfully made a move
+    }
+
+    // Human player logic
+    char input[10];
+    int move;
+    int result = 0;
+
+    while (1)
+    {
+        printf("Enter the identifier for your chosen move: ");
+        scanf("%s", input); // Read input as a string
+
+        // Check if the input is a valid number
+        int validInput = 1; // Flag to check if input is valid
+        for (size_t i = 0; i < strlen(input); i++)
+        {
+            if (!isdigit(input[i]))
+            {
+                validInput = 0; // Not a valid number
+                break;
+            }
+        }
+
+        if (validInput)
+        {
+            move = atoi(input); // Convert string to integer
+
+            // Check if the move is within the valid range
+            if (move >= 0 && move < MOVES_COUNT)
+            {
+                checkOneRoundMoves(player, move);
+
+                if (!checkAvailable(player, move))
+                {
+                    PROBE_RETURN(probeMakeMove, 0); // Invalid move available
+                }
+
+                switch (move)
+                {
+                case 0:
+                    result = fire(player, opponent, 0);
+                    break;
+                case 1:
+                    result = radarSweep(player, opponent);
+                    break;
+                case 2:
+                    result = smokeScreen(player, opponent);
+                    break;
+                case 3:
+                    result = artillery(player, opponent, 0);
+                    break;
+                case 4:
+                    result = torpedo(player, opponent, 0);
+                    break;
+                default:
+                    break;
+                }
+
+                if (result && player->moves[move].countAvailable > 0) // FIRE (-1) is unlimited
+                {
+                    player->moves[move].countAvailable--;
+                }
+                if (result)
+                {
+                    player->lastMove = move;
+                }
+
+                break; // Exit the loop after a valid move
+            }
+        }
+
+        // If input is not a valid number or not in range
+        printf("\nInvalid input! Please choose again from the list of available moves using the specified format:\n\n");
+    }
+
+    PROBE_RETURN(probeMakeMove, 1); // Return success
+}
+
+int decideTarget(Player *bot) // returns 1 if target meaninfully, 0 if target randomly
+{
+    int percentage = 0;
+    int randVal;
+    if (bot->difficulty == 0) // bot difficulty: easy
+    {
+        percentage = 50;
+    }
+    else if (bot->difficulty == 1) // medium
+    {
+        percentage = 75;
+    }
+    else // hard
+    {
+        percentage = 100;
+    }
+    randVal = rngBounded(bot->rng, 101);
+    if (randVal <= percentage)
+    {
+        return 1;
+    }
+    return 0;
+}
+
+void setCoordsMeaningfully(Player *player, Player *opponent, int *row, int *col)
+{
+    PROBE_BEGIN(probeSetCoordsMeaningfully);
+        if (player->difficulty == densityBot) {
+            densityBestCell(player, opponent, row, col);
+            PROBE_RETURN_VOID(probeSetCoordsMeaningfully);
+        }
+
+        if (player->difficulty == monteCarloBot) {
+            monteCarloBestTarget(player, opponent, 0, row, col);
+            PROBE_RETURN_VOID(probeSetCoordsMeaningfully);
+        }
+
+        if (cellSetPopFront(player->radaredList, row, col)) {
+            PROBE_RETURN_VOID(probeSetCoordsMeaningfully);
+        }
+
+        if (player->botHitList->count == 0)
+        {
+            searchForHits(player, opponent, row, col);
+        }
+        else
+        {
+
+            int direction = 0;
+
+            int current = cellSetGet(player->botHitList, 0);
+            int baseRow = current / GRID_SIZE;
+            int baseCol = current % GRID_SIZE;
+
+            for (int i = 0; i < 4; i++)
+            {
+                int targetRow = baseRow, targetCol = baseCol;
+
+                // hit's neighbors
+                switch(direction)
+                {
+                case 0:
+                    targetRow++;
+                    break; // Down
+                case 1:
+                    targetRow--;
+                    break; // Up
+                case 2:
+                    targetCol--;
+                    break; // Left
+                case 3:
+                    targetCol++;
+                    break; // Right
+                }
+
+                // // Checking  bounds and whether the cell is undiscovered
+                if (targetRow >= 0 && targetRow < GRID_SIZE &&
+                    targetCol >= 0 && targetCol < GRID_SIZE &&
+                    !isDiscovered(&opponent->board, targetRow, targetCol))
+                {
+                    *row = targetRow;
+                    *col = targetCol;
+                    PROBE_RETURN_VOID(probeSetCoordsMeaningfully);
+                }
+
+                // Rotate direction clockwise: if the current direction does not lead to a valid cell-->rotates to the next direction
+                direction = (direction + 1) % 4;
+            }
+
+            searchForHits(player, opponent, row, col);
+        }
+    PROBE_END(probeSetCoordsMeaningfully);
+}
+
+//when the hitList is empty, it chooses coordinates with higher chance of having a ship
+void searchForHits(Player *player, Player *opponent, int* row, int* col) {
+    PROBE_BEGIN(probeSearchForHits);
+    if (player->openingBook != NULL && openingMove(player->openingBook, &opponent->board, row, col)) {
+        PROBE_RETURN_VOID(probeSearchForHits);
+    }
+
+    int coordsToCheck[9][2] = {
+            {0, 0}, {0, 4}, {0, 9},
+            {4, 0}, {4, 4}, {4, 9},
+            {9, 0}, {9, 4}, {9, 9}
+        };
+
+    for (int i = 0; i < 9; i++) {
+        int targetCol = coordsToCheck[i][0];
+        int targetRow = coordsToCheck[i][1];
+
+        if (targetRow >= 0 && targetRow < GRID_SIZE &&
+            targetCol >= 0 && targetCol < GRID_SIZE &&
+            !isDiscovered(&opponent->board, targetRow, targetCol)) {
+
+            *row = targetRow;
+            *col = targetCol;
+            PROBE_RETURN_VOID(probeSearchForHits);
+        }
+    }
+
+    //if all were visited, choose random coordinates
+    do {
+        COUNT(counterRandomRetries, 1);
+        *row = randomCoordinate(player->rng, GRID_SIZE);
+        *col = randomCoordinate(player->rng, GRID_SIZE);
+    } while (isDiscovered(&opponent->board, *row, *col));
+
+    PROBE_END(probeSearchForHits);
+}
+
+int fire(Player *player, Player *opponent, int decision)
+{
+    PROBE_BEGIN(probeFire);
+    int row = -1, col = -1;
+
+    if (player->isBot)
+    {
+        if (decision == 1) // target meaningfully
+        {
+            /*setCoordsMeaningfully(player, opponent, &row, &col);*/
+            setCoordsMeaningfully(player, opponent, &row, &col);
+        }
+        else // target randomly
+        {
+            do
+            {
+                COUNT(counterRandomRetries, 1);
+                row = randomCoordinate(player->rng, GRID_SIZE);
+                col = randomCoordinate(player->rng, GRID_SIZE);
+            } while (isDiscovered(&opponent->board, row, col));
+        }
+    }
+    else
+    {
+        // Human Player Logic
+        char cl;
+        int rw;
+
+        printf("\nEnter coordinate (e.g. B3): ");
+        scanf(" %c%d", &cl, &rw);
+
+        row = rw - 1;
+        col = cl - 'A';
+
+        if (row < 0 || row >= GRID_SIZE || col < 0 || col >= GRID_SIZE)
+        {
+            printf("\nInvalid coordinates! You lose your turn :(\n");
+            PROBE_RETURN(probeFire, 0);
+        }
+    }
+
+    // Fire at the chosen coordinates
+    resolveMove(player, opponent, 0, row, col);
+    PROBE_RETURN(probeFire, 1);
+}
+
+int radarSweep(Player *player, Player *opponent)
+{
+    PROBE_BEGIN(probeRadarSweep);
+    int row = -1, col = -1;
+
+    if (player->isBot)
+    {   
+        if (player->difficulty == monteCarloBot)
+        {
+            monteCarloBestTarget(player, opponent, 1, &row, &col);
+        }
+        else if (player->botHitList->count > 0)
+        {
+            chooseTopLeftMeaningfully(player->botHitList, player->radaredList->members, &row, &col);
+        }
+        // randomly select a valid top-left coordinate if no hit gave us an undiscovered one
+        // (chooseTopLeftMeaningfully is deterministic, retrying it would never end)
+        if (row < 0 || col < 0 || isDiscovered(&opponent->board, row, col))
+        {
+            int tries = 0;
+            do
+            {
+                COUNT(counterRadarRetries, 1);
+                row = randomCoordinate(player->rng, GRID_SIZE - 1);
+                col = randomCoordinate(player->rng, GRID_SIZE - 1);
+            } while (isDiscovered(&opponent->board, row, col) && ++tries < GRID_SIZE * GRID_SIZE);
+        }
+    }
+    else
+    {
+        // Human Player Logic
+        char cl;
+        int rw;
+
+        printf("\nEnter top-left coordinate (e.g. B3): ");
+        scanf(" %c%d", &cl, &rw);
+
+        row = rw - 1;
+        col = cl - 'A';
+
+        if (!validTopLeftCoordinate(row, col))
+        {
+            PROBE_RETURN(probeRadarSweep, 0);
+        }
+    }
+
+    resolveMove(player, opponent, 1, row, col);
+    PROBE_RETURN(probeRadarSweep, 1);
+}
+
+int smokeScreen(Player *player, Player *opponent)
+{
+    PROBE_BEGIN(probeSmokeScreen);
+    int row = -1, col = -1;
+
+    if (player->isBot)
+    {
+        chooseTopLeftMeaningfully(player->botsShipsCoord, player->board.smoke, &row, &col);
+        if (row < 0 || col < 0) // every ship cell is already smoked
+        {
+            row = randomCoordinate(player->rng, GRID_SIZE - 1);
+            col = randomCoordinate(player->rng, GRID_SIZE - 1);
+        }
+    }
+    else
+    {
+        // Human Player Logic
+        char cl;
+        int rw;
+
+        printf("\nEnter top-left coordinate (e.g. B3): ");
+        scanf(" %c%d", &cl, &rw);
+
+        row = rw - 1;
+        col = cl - 'A';
+
+        if (!validTopLeftCoordinate(row, col))
+        {
+            // printf("\nInvalid coordinates! You lose your turn :(\n");
+            PROBE_RETURN(probeSmokeScreen, 0);
+        }
+    }
+
+    if (!(player->isBot))
+        getchar(); // the rest of the coordinate line, before the console reports
+    resolveMove(player, opponent, 2, row, col);
+    if (!(player->isBot))
+    {
+        getchar();
+        system("cls");
+    }
+    PROBE_RETURN(probeSmokeScreen, 1);
+}
+
+int artillery(Player *player, Player *opponent, int decision)
+{
+    PROBE_BEGIN(probeArtillery);
+    int row = -1, col = -1;
+
+    if (player->isBot)
+    {
+        if (decision == 1 && player->difficulty == monteCarloBot)
+        {
+            monteCarloBestTarget(player, opponent, 3, &row, &col);
+        }
+        else if (decision == 1 && player->difficulty == densityBot)
+        {
+            densityBestSquare(player, opponent, &row, &col);
+        }
+        else if (decision == 1) // target meaningfully
+        {
+            setCoordsMeaningfully(player, opponent, &row, &col);
+            // keep the target inside the 2x2 area instead of asking again for the same cell
+            if (row == GRID_SIZE - 1)
+                row--;
+            if (col == GRID_SIZE - 1)
+                col--;
+        }
+        else // target randomly
+        {
+            int tries = 0;
+            do
+            {
+                COUNT(counterArtilleryRetries, 1);
+                row = randomCoordinate(player->rng, GRID_SIZE - 1);
+                col = randomCoordinate(player->rng, GRID_SIZE - 1);
+            } while (isDiscovered(&opponent->board, row, col) && ++tries < GRID_SIZE * GRID_SIZE);
+        }
+    }
+    else
+    {
+        // Human Player Logic
+        char cl;
+        int rw;
+
+        printf("\nEnter top-left coordinate (e.g. B3): ");
+        scanf(" %c%d", &cl, &rw);
+
+        row = rw - 1;
+        col = cl - 'A';
+
+        if (!validTopLeftCoordinate(row, col))
+        {
+            // printf("\nInvalid coordinates! You lose your turn :(\n");
+            PROBE_RETURN(probeArtillery, 0);
+        }
+    }
+        
+    
+
+    // Artillery Logic
+    resolveMove(player, opponent, 3, row, col);
+    PROBE_RETURN(probeArtillery, 1);
+}
+
+int torpedo(Player *player, Player *opponent, int decision)
+{
+    PROBE_BEGIN(probeTorpedo);
+    int row = -1;
+    int col = -1;
+
+    if (player->isBot)
+    {
+        if (decision == 1 && player->difficulty == monteCarloBot)
+        {
+            monteCarloBestTarget(player, opponent, 4, &row, &col);
+        }
+        else if (decision == 1 && player->difficulty == densityBot)
+        {
+            densityBestLine(player, opponent, &row, &col);
+        }
+        else if (decision == 1)     // target meaningfully
+        {                           // BRUTEFORCE
+            int isRow = rngBounded(player->rng, 2); // Randomly choose between row or column
+            setCoordsMeaningfully(player, opponent, &row, &col);
+            if (isRow)
+            {
+                col = -1;
+            }
+            else
+            {
+                row = -1;
+            }
+        }
+        else // target randomly
+        {
+            int isRow = rngBounded(player->rng, 2); // Randomly choose between row or column
+            if (isRow)
+            {
+                row = randomCoordinate(player->rng, GRID_SIZE);
+            }
+            else
+            {
+                col = randomCoordinate(player->rng, GRID_SIZE);
+            }
+        }
+    }
+    else
+    {
+        // Human Player Logic
+        char input;
+        printf("\nEnter row (e.g. 3) or column (e.g. B): ");
+        scanf(" %c", &input);
+
+        // Validate input
+        if (input >= 'A' && input <= 'J')
+        {
+            col = input - 'A';
+        }
+        else if (input >= '1' && input <= '9' + 1)
+        {
+            row = input - '1';
+        }
+        else
+        {
+            printf("\nInvalid coordinates! You lose your turn :(\n");
+            getchar();
+            PROBE_RETURN(probeTorpedo, 0);
+        }
+    }
+
+    // Perform Torpedo Logic
+    resolveMove(player, opponent, 4, row, col);
+    PROBE_RETURN(probeTorpedo, 1);
+}
+
+// the rules of a move at a target already chosen (torpedo: row or col is -1), shared by the move
+// functions and replays. Returns what the move found: new hits, radar contacts or cells smoked
+int resolveMove(Player *player, Player *opponent, int move, int row, int col)
+{
+    if (move == 1) // radar sweep: undiscovered ship cells that are not hidden by smoke
+    {
+        Board *board = &opponent->board;
+        Bitboard found = bbAndNot(bbAndNot(bbAnd(bbSquare(row, col), board->ships), board->hits), board->smoke);
+        emitEvent(player, opponent, eventRadar, 1, row, col, -1, bbCount(found));
+        if (player->isBot)
+        {
+            for (int i = 0; i < 2; i++)
+            {
+                for (int j = 0; j < 2; j++)
+                {
+                    cellSetAdd(player->radaredList, row + i, col + j);
+                    if (bbTest(found, row + i, col + j))
+                    {
+                        cellSetAdd(player->foundShips, row + i, col + j);
+                    }
+                }
+            }
+        }
+        return bbCount(found);
+    }
+    if (move == 2) // smoke screen: hide the ship cells of the area that are not hit yet
+    {
+        Board *board = &player->board;
+        Bitboard hidden = bbAndNot(bbAnd(bbSquare(row, col), board->ships), board->hits);
+        board->smoke = bbOr(board->smoke, hidden);
+        emitEvent(player, opponent, eventSmoke, 2, row, col, -1, bbCount(hidden));
+        return bbCount(hidden);
+    }
+
+    Bitboard target = moveTarget(move, row, col);
+    emitEvent(player, opponent, eventShot, move, row, col, -1, 0);
+    int h = strike(player, opponent, target); // Number of hits
+    emitEvent(player, opponent, h > 0 ? eventHit : eventMiss, move, row, col, -1, h);
+    return h;
+}
+
+// resolve an attack on every cell of target: ship cells become hits, everything else a miss
+// returns the number of new hits
+int strike(Player *player, Player *opponent, Bitboard target)
+{
+    Board *board = &opponent->board;
+    Bitboard newHits = bbAndNot(bbAnd(target, board->ships), board->hits);
+
+    board->hits = bbOr(board->hits, newHits);
+    board->misses = bbOr(board->misses, bbAndNot(target, board->ships));
+
+    int h = bbCount(newHits);
+    while (bbAny(newHits)) // row by row, left to right
+    {
+        int cell = bbPopFirst(&newHits);
+        hitShip(opponent, cell);
+        if (player->isBot)
+            cellSetAdd(player->botHitList, cell / GRID_SIZE, cell % GRID_SIZE);
+    }
+    return h;
+}
+
+int hitShip(Player *opponent, int cell)
+{
+    int k = opponent->board.shipAt[cell] - 1;
+    if (--opponent->ships[k].remainingHits != 0)
+        return -1;
+    opponent->sinking |= 1 << k; // counted by updateGameState()
+    return k;
+}
+
+void cellSetAdd(CellSet *set, int row, int col)
+{
+    if (cellSetContains(set, row, col))
+    {
+        return;
+    }
+    set->members = bbOr(set->members, bbCell(row, col));
+    set->cells[set->count++] = (unsigned char)(row * GRID_SIZE + col); // the newest cell is the front
+    COUNT(counterCellSetAdds, 1);
+    COUNT(counterCellSetLength, set->count);
+}
+
+// remove a cell from the set, keeping the order of the others
+void cellSetRemove(CellSet *set, int row, int col)
+{
+    if (!cellSetContains(set, row, col))
+    {
+        return;
+    }
+    set->members = bbAndNot(set->members, bbCell(row, col));
+    int i = 0;
+    while (set->cells[i] != row * GRID_SIZE + col)
+        i++;
+    memmove(&set->cells[i], &set->cells[i + 1], set->count - i - 1);
+    set->count--;
+}
+
+int cellSetPopFront(CellSet *set, int *row, int *col)
+{
+    if (set->count == 0)
+    {
+        return 0;
+    }
+    int cell = set->cells[--set->count];
+    set->members = bbAndNot(set->members, bbCell(cell / GRID_SIZE, cell % GRID_SIZE));
+    *row = cell / GRID_SIZE;
+    *col = cell % GRID_SIZE;
+    return 1;
+}
+
+int cellSetGet(CellSet *set, int i)
+{
+    return set->cells[set->count - 1 - i];
+}
+int randomCoordinate(Rng *rng, int upperBound)
+{
+    return (int)rngBounded(rng, upperBound);
+}
+
+/*---------------------------------------------------------------Events---------------------------------------------------------------------*/
+
+// the only way results leave the engine; with nobody listening it costs a pointer test
+void emitEvent(Player *player, Player *opponent, int type, int move, int row, int col, int ship, int count)
+{
+    if (player->events == NULL)
+        return;
+    GameEvent event = {type, player, opponent, move, row, col, ship, count};
+    player->events->handler(&event, player->events->context);
+}
+
+// the text the game has always printed: bots announce their moves, humans hear what their radar found
+void consoleEvents(GameEvent *event, void *context)
+{
+    const char *announcements[MOVES_COUNT] = {"Bot performing Fire.", "Bot performs Radar Sweep.", "Bot uses Smoke Screen.",
+                                              "Bot fires Artillery.", "Bot fires Torpedo."};
+    Player *player = event->player;
+    Player *opponent = event->opponent;
+    (void)context;
+
+    switch (event->type)
+    {
+    case eventShot:
+    case eventRadar:
+    case eventSmoke:
+        if (player->isBot)
+            printf("%s\n", announcements[event->move]);
+        if (event->type == eventRadar && !player->isBot)
+            printf(event->count > 0 ? "\nResult: enemy ships found!\n" : "\nResult: no enemy ships found!\n");
+        if (event->type == eventSmoke && !player->isBot)
+            printf("\nSMOKE SCREEN performed! Press enter to proceed \n");
+        break;
+    case eventHit:
+        printf("\nResult: hit!\n");
+        break;
+    case eventMiss:
+        printf("\nResult: miss!\n");
+        break;
+    case eventSink:
+        printf("\nOne of %s's ships, a %s, has been sunk!\n", opponent->name, getShipName(event->ship + 2));
+        break;
+    case eventGameOver:
+        printf("All of %s's ships have been sunk! %s wins, congrats :)", opponent->name, player->name);
+        break;
+    default: // nothing to say about unlocked moves, the move menu shows them
+        break;
+    }
+}
+
+/*-------------------------------------------------------------Make/Unmake------------------------------------------------------------------*/
+
+// a move at a chosen target, like makeMove() and takeTurn() apply it, but silent and reversible.
+// Bot memory built while choosing targets (density tracker, sunk attribution) is not part of a move.
+int doMove(Player *player, Player *opponent, int move, int row, int col, UndoStack *stack)
+{
+    if (stack->depth == UNDO_DEPTH)
+    {
+        printf("Undo stack is full\n");
+        exit(1);
+    }
+    UndoRecord *undo = &stack->records[stack->depth++];
+    Board *board = &opponent->board;
+    Bitboard hits = board->hits;
+    Bitboard misses = board->misses;
+    Bitboard smoke = player->board.smoke;
+    int afloat = 0;
+    for (int k = 0; k < SHIPS_COUNT; k++)
+        afloat |= (opponent->ships[k].remainingHits > 0) << k;
+    for (int m = 0; m < MOVES_COUNT; m++)
+        undo->countAvailable[m] = (signed char)player->moves[m].countAvailable;
+    undo->lastMove = (signed char)player->lastMove;
+    undo->hitList = undo->radaredList = undo->foundShips = 0;
+    if (player->isBot)
+    {
+        undo->hitList = (unsigned char)player->botHitList->count;
+        undo->radaredList = (unsigned char)player->radaredList->count;
+        undo->foundShips = (unsigned char)player->foundShips->count;
+    }
+
+    EventSink *events[2] = {player->events, opponent->events}; // search is not news
+    player->events = opponent->events = NULL;
+    if (!player->isBot)
+        checkOneRoundMoves(player, move);
+    int outcome = resolveMove(player, opponent, move, row, col);
+    if (player->moves[move].countAvailable > 0)
+        player->moves[move].countAvailable--;
+    player->lastMove = move;
+    updateGameState(opponent, player);
+    player->events = events[0];
+    opponent->events = events[1];
+
+    undo->newHits = bbAndNot(board->hits, hits);
+    undo->newMisses = bbAndNot(board->misses, misses);
+    undo->newSmoke = bbAndNot(player->board.smoke, smoke);
+    undo->sunk = 0;
+    for (int k = 0; k < SHIPS_COUNT; k++)
+        undo->sunk |= (((afloat >> k) & 1) && opponent->ships[k].remainingHits < 0) << k;
+    return outcome;
+}
+
+void undoMove(Player *player, Player *opponent, UndoStack *stack)
+{
+    UndoRecord *undo = &stack->records[--stack->depth];
+    Board *board = &opponent->board;
+    board->hits = bbAndNot(board->hits, undo->newHits);
+    board->misses = bbAndNot(board->misses, undo->newMisses);
+    player->board.smoke = bbAndNot(player->board.smoke, undo->newSmoke);
+    for (int k = 0; k < SHIPS_COUNT; k++)
+    {
+        if ((undo->sunk >> k) & 1) // -1 again means afloat at 0, see updateGameState()
+        {
+            opponent->ships[k].remainingHits = 0;
+            opponent->shipsSunk--;
+        }
+        opponent->ships[k].remainingHits += bbCount(bbAnd(undo->newHits, board->shipMask[k]));
+    }
+    for (int m = 0; m < MOVES_COUNT; m++)
+        player->moves[m].countAvailable = undo->countAvailable[m];
+    player->lastMove = undo->lastMove;
+    if (player->isBot)
+    {
+        cellSetTruncate(player->botHitList, undo->hitList);
+        cellSetTruncate(player->radaredList, undo->radaredList);
+        cellSetTruncate(player->foundShips, undo->foundShips);
+    }
+}
+
+void cellSetTruncate(CellSet *set, int count)
+{
+    while (set->count > count)
+    {
+        int cell = set->cells[--set->count];
+        set->members = bbAndNot(set->members, bbCell(cell / GRID_SIZE, cell % GRID_SIZE));
+    }
+}
+
+/*----------------------------------------------------------Random Numbers--------------------------------------------------------------------*/
+
+// xoshiro256** (Blackman & Vigna), one generator per game so games are reproducible and threads never share state
+
+uint64_t splitMix64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void rngSeed(Rng *rng, uint64_t seed)
+{
+    // expand the seed with SplitMix64, which never yields the all-zero state xoshiro cannot leave
+    for (int i = 0; i < 4; i++)
+        rng->s[i] = splitMix64(&seed);
+}
+
+uint64_t rngNext(Rng *rng)
+{
+    uint64_t *s = rng->s;
+    uint64_t x = s[1] * 5;
+    uint64_t result = ((x << 7) | (x >> 57)) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 45) | (s[3] >> 19);
+    COUNT(counterRngDraws, 1);
+    return result;
+}
+
+// unbiased number in [0, bound), Lemire's multiply-and-reject instead of rand() % bound
+uint32_t rngBounded(Rng *rng, uint32_t bound)
+{
+    uint64_t m = (rngNext(rng) >> 32) * bound;
+    uint32_t low = (uint32_t)m;
+    if (low < bound)
+    {
+        uint32_t threshold = (0u - bound) % bound;
+        while (low < threshold)
+        {
+            m = (rngNext(rng) >> 32) * bound;
+            low = (uint32_t)m;
+        }
+    }
+    return (uint32_t)(m >> 32);
+}
+
+// seed of one game of a tournament, independent of which thread plays it
+uint64_t gameSeed(uint64_t tournamentSeed, int pairing, long game)
+{
+    uint64_t state = tournamentSeed ^ ((uint64_t)pairing << 48) ^ (uint64_t)game;
+    return splitMix64(&state);
+}
+
+void checkOneRoundMoves(Player *player, int move)
+{
+
+    int movesToCheck[2] = {3, 4};
+
+    for (int i = 0; i < 2; i++)
+    {
+        if (move != movesToCheck[i] && player->moves[movesToCheck[i]].countAvailable == 1)
+        {
+            player->moves[movesToCheck[i]].countAvailable--;
+        }
+    }
+}
+
+int checkAvailable(Player *player, int move)
+{
+    if (player->moves[move].countAvailable == 0)
+    {
+        printf("\nOops, you don't have an available %s move! You lost your turn :(\n", player->moves[move].name);
+        getchar();
+        return 0;
+    }
+    return 1;
+}
+
+int botCheckAvailable(Player *player, int moveChosen)
+{
+    if (player->moves[moveChosen].countAvailable == 0)
+    {
+        return 0;
+    }
+    return 1;
+}
+
+void chooseTopLeftMeaningfully(CellSet *cells, Bitboard skip, int *row, int *col)
+{
+    for (int i = 0; i < cells->count; i++)
+    {
+        int current = cellSetGet(cells, i);
+        if (!bbTest(skip, current / GRID_SIZE, current % GRID_SIZE))
+        {
+            chooseTopLeftMeaningfullyHelper(current / GRID_SIZE, current % GRID_SIZE, row, col);
+            return;
+        }
+    }
+}
+
+void chooseTopLeftMeaningfullyHelper(int cellRow, int cellCol, int *row, int *col)
+{
+    if (cellRow < 9 && cellRow >= 0 && cellCol < 9 && cellCol >= 0)
+    {
+        *row = cellRow;
+        *col = cellCol;
+    }
+    else if (!(cellRow < 9 && cellRow >= 0) && (cellCol < 9 && cellCol >= 0))
+    {
+        *row = cellRow - 1;
+        *col = cellCol;
+    }
+    else if (!(cellCol < 9 && cellCol >= 0) && (cellRow < 9 && cellRow >= 0))
+    {
+        *col = cellCol - 1;
+        *row = cellRow;
+    }
+    else
+    {
+        *row = cellRow - 1;
+        *col = cellCol - 1;
+    }
+}
+
+int validTopLeftCoordinate(int row, int col)
+{
+    if (row < 9 && row >= 0 && col < 9 && col >= 0)
+    {
+        return 1;
+    }
+    printf("\nInvalid coordinates! You lost your turn :(\n");
+    getchar();
+    return 0;
+}
+
+int cellSetContains(CellSet *set, int row, int col)
+{
+    PROBE_BEGIN(probeCellSetContains);
+    int found = bbTest(set->members, row, col);
+    PROBE_RETURN(probeCellSetContains, found);
+}
+
+void updateGameState(Player *opponent, Player *player)
+{
+    while (opponent->sinking != 0) // only the ships hitShip() saw sink, smallest first
+    {
+        int i = lowestBit64((uint64_t)opponent->sinking);
+        opponent->sinking &= opponent->sinking - 1;
+        opponent->ships[i].remainingHits--; // when we sink the next ship, the current sunk ship has remaining hits = -1, so we do not print about it :)
+        opponent->shipsSunk++;
+        emitEvent(player, opponent, eventSink, -1, -1, -1, i, opponent->shipsSunk);
+        updateMoves(opponent, player);
+    }
+}
+
+void updateMoves(Player *opponent, Player *player)
+{
+    for (int j = 0; j < MOVES_COUNT; j++)
+    {
+        if (player->moves[j].shipsSunkToUnlock <= opponent->shipsSunk && player->moves[j].countAvailable >= 0)
+        {
+            player->moves[j].countAvailable++;
+            emitEvent(player, opponent, eventMoveUnlocked, j, -1, -1, -1, player->moves[j].countAvailable);
+        }
+    }
+}
+
+int gameOver(Player *opponent, Player *player)
+{
+
+    if (opponent->shipsSunk == 4)
+    {
+        emitEvent(player, opponent, eventGameOver, -1, -1, -1, -1, 0);
+        getchar();
+        return 1;
+    }
+    return 0;
+}
+
+void freeAll(Player *player)
+{
+    if (player->arena != NULL) // goes with the arena
+        return;
+
+    free(player->ships);
+    free(player->moves);
+
+    if (player->isBot)
+    {
+        freeCellSet(player->botHitList);
+        freeCellSet(player->botsShipsCoord);
+        freeCellSet(player->radaredList);
+        freeCellSet(player->foundShips);
+        free(player->densityTracker);
+        free(player->endgame);
+    }
+}
+
+void freeCellSet(CellSet *set)
+{
+    free(set); // fixed capacity, the cells live inside the set
+}
+
+/*-------------------------------------------------------------Density Bot------------------------------------------------------------------*/
+
+#define TARGET_WEIGHT 4  // a placement through k unresolved hits weighs 2^(TARGET_WEIGHT * k)
+
+// a newly sunk ship must lie on hits the bot has not explained yet, preferably through its last hit
+void updateSunkKnowledge(Player *bot, Player *opponent)
+{
+    for (int k = 0; k < SHIPS_COUNT; k++)
+    {
+        if (opponent->ships[k].remainingHits > 0 || ((bot->sunkSeen >> k) & 1))
+            continue;
+        bot->sunkSeen |= 1 << k;
+
+        int last = bot->botHitList->count > 0 ? cellSetGet(bot->botHitList, 0) : -1;
+        Bitboard unresolved = bbAndNot(opponent->board.hits, bot->sunkCells);
+        Bitboard sunk = bbFromBits(0);
+        for (int p = 0; p < placements.count[k]; p++)
+        {
+            Bitboard cells = placements.mask[k][p];
+            if (bbAny(bbAndNot(cells, unresolved)))
+                continue;
+            if (!bbAny(sunk) || (last >= 0 && bbTest(cells, last / GRID_SIZE, last % GRID_SIZE)))
+                sunk = cells;
+        }
+        bot->sunkCells = bbOr(bot->sunkCells, sunk);
+    }
+}
+
+DensityTracker *createDensityTracker(Arena *arena)
+{
+    DensityTracker *tracker = (DensityTracker *)allocate(arena, sizeof(DensityTracker));
+    memset(tracker, 0, sizeof(DensityTracker));
+
+    for (int k = 0; k < SHIPS_COUNT; k++)
+    {
+        memset(tracker->valid[k], 1, placements.count[k]);
+    }
+    for (int cell = 0; cell < GRID_SIZE * GRID_SIZE; cell++)
+    {
+        int density = 0;
+        for (int k = 0; k < SHIPS_COUNT; k++)
+            density += placements.coverCount[k][cell];
+        tracker->density[cell] = (unsigned char)density;
+        tracker->bucket[density] = bbOr(tracker->bucket[density], bbCell(cell / GRID_SIZE, cell % GRID_SIZE));
+    }
+    tracker->top = MAX_DENSITY;
+    return tracker;
+}
+
+// apply what happened since the last call: only placements through newly revealed cells change
+void densitySync(Player *bot, Player *opponent)
+{
+    DensityTracker *tracker = bot->densityTracker;
+    Board *board = &opponent->board;
+
+    updateSunkKnowledge(bot, opponent);
+
+    for (int k = 0; k < SHIPS_COUNT; k++) // a sunk ship has no placements left
+    {
+        if (opponent->ships[k].remainingHits > 0 || ((tracker->sunkApplied >> k) & 1))
+            continue;
+        tracker->sunkApplied |= 1 << k;
+        for (int p = 0; p < placements.count[k]; p++)
+        {
+            if (tracker->valid[k][p])
+                invalidatePlacement(tracker, k, p);
+        }
+    }
+
+    Bitboard blocked = bbAndNot(bbOr(board->misses, bot->sunkCells), tracker->blocked);
+    tracker->blocked = bbOr(tracker->blocked, blocked);
+    while (bbAny(blocked))
+        invalidateCell(tracker, opponent, bbPopFirst(&blocked));
+
+    Bitboard discovered = bbAndNot(bbOr(board->hits, board->misses), tracker->discovered);
+    tracker->discovered = bbOr(tracker->discovered, discovered);
+    while (bbAny(discovered))
+    {
+        int cell = bbPopFirst(&discovered);
+        Bitboard *bucket = &tracker->bucket[tracker->density[cell]];
+        *bucket = bbAndNot(*bucket, bbCell(cell / GRID_SIZE, cell % GRID_SIZE));
+    }
+}
+
+// no ship afloat can lie on the cell anymore
+void invalidateCell(DensityTracker *tracker, Player *opponent, int cell)
+{
+    for (int k = 0; k < SHIPS_COUNT; k++)
+    {
+        if (opponent->ships[k].remainingHits <= 0)
+            continue;
+        for (int i = 0; i < placements.coverCount[k][cell]; i++)
+        {
+            int p = placements.cover[k][cell][i];
+            if (tracker->valid[k][p])
+                invalidatePlacement(tracker, k, p);
+        }
+    }
+}
+
+void invalidatePlacement(DensityTracker *tracker, int k, int p)
+{
+    tracker->valid[k][p] = 0;
+    for (int i = 0; i < k + 2; i++)
+    {
+        int cell = placements.cells[k][p][i];
+        int density = tracker->density[cell]--;
+        Bitboard bit = bbCell(cell / GRID_SIZE, cell % GRID_SIZE);
+        if (!bbTest(tracker->discovered, cell / GRID_SIZE, cell % GRID_SIZE)) // move it one bucket down
+        {
+            tracker->bucket[density] = bbAndNot(tracker->bucket[density], bit);
+            tracker->bucket[density - 1] = bbOr(tracker->bucket[density - 1], bit);
+        }
+    }
+}
+
+// an undiscovered cell of the highest density, uniform among equals; densities only ever drop,
+// so the top bucket pointer only moves down: O(1) amortized
+int densityBest(DensityTracker *tracker, Rng *rng)
+{
+    while (tracker->top > 0 && !bbAny(tracker->bucket[tracker->top]))
+        tracker->top--;
+
+    Bitboard best = tracker->bucket[tracker->top];
+    int pick = rngBounded(rng, bbCount(best));
+    while (pick-- > 0)
+        bbPopFirst(&best);
+    return bbPopFirst(&best);
+}
+
+// density[cell] of every undiscovered cell, given what the bot has seen
+void densityMap(Player *bot, Player *opponent, int density[])
+{
+    densitySync(bot, opponent);
+
+    Bitboard unresolved = bbAndNot(opponent->board.hits, bot->sunkCells);
+    if (bbAny(unresolved) && targetDensity(bot, opponent, unresolved, density))
+        return;
+
+    DensityTracker *tracker = bot->densityTracker;
+    for (int cell = 0; cell < GRID_SIZE * GRID_SIZE; cell++)
+        density[cell] = bbTest(tracker->discovered, cell / GRID_SIZE, cell % GRID_SIZE) ? 0 : tracker->density[cell];
+}
+
+// hits to follow: only valid placements through unresolved hits count, the more hits the heavier
+// returns 0 if no placement explains any of them
+int targetDensity(Player *bot, Player *opponent, Bitboard unresolved, int density[])
+{
+    DensityTracker *tracker = bot->densityTracker;
+    int found = 0;
+
+    memset(density, 0, sizeof(int) * GRID_SIZE * GRID_SIZE);
+    Bitboard hits = unresolved;
+    while (bbAny(hits))
+    {
+        int cell = bbPopFirst(&hits);
+        for (int k = 0; k < SHIPS_COUNT; k++)
+        {
+            if (opponent->ships[k].remainingHits <= 0)
+                continue;
+            for (int i = 0; i < placements.coverCount[k][cell]; i++)
+            {
+                int p = placements.cover[k][cell][i];
+                if (!tracker->valid[k][p])
+                    continue;
+                Bitboard covered = bbAnd(placements.mask[k][p], unresolved);
+                if (bbPopFirst(&covered) != cell) // count each placement once, at its first unresolved hit
+                    continue;
+                int covers = 1 + bbCount(covered);
+                Bitboard targets = bbAndNot(placements.mask[k][p], opponent->board.hits);
+                while (bbAny(targets))
+                {
+                    density[bbPopFirst(&targets)] += 1 << (TARGET_WEIGHT * covers);
+                    found = 1;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+void densityBestCell(Player *bot, Player *opponent, int *row, int *col)
+{
+    densitySync(bot, opponent);
+
+    int best = -1;
+    Bitboard unresolved = bbAndNot(opponent->board.hits, bot->sunkCells);
+    int density[GRID_SIZE * GRID_SIZE];
+    if (bbAny(unresolved) && targetDensity(bot, opponent, unresolved, density))
+    {
+        int ties = 0;
+        for (int cell = 0; cell < GRID_SIZE * GRID_SIZE; cell++)
+        {
+            if (density[cell] == 0)
+                continue;
+            if (best < 0 || density[cell] > density[best])
+            {
+                best = cell;
+                ties = 1;
+            }
+            else if (density[cell] == density[best] && rngBounded(bot->rng, ++ties) == 0) // uniform among equals
+            {
+                best = cell;
+            }
+        }
+    }
+    else
+    {
+        best = densityBest(bot->densityTracker, bot->rng);
+    }
+    *row = best / GRID_SIZE;
+    *col = best % GRID_SIZE;
+}
+
+void densityBestSquare(Player *bot, Player *opponent, int *row, int *col)
+{
+    int density[GRID_SIZE * GRID_SIZE];
+    densityMap(bot, opponent, density);
+    densityPickSquare(density, bot->rng, row, col);
+}
+
+// best row or column for a torpedo, the other coordinate is set to -1
+void densityBestLine(Player *bot, Player *opponent, int *row, int *col)
+{
+    int density[GRID_SIZE * GRID_SIZE];
+    densityMap(bot, opponent, density);
+    densityPickLine(density, bot->rng, row, col);
+}
+
+int densityPickCell(int density[], Bitboard discovered, Rng *rng)
+{
+    int best = -1, ties = 0;
+    for (int cell = 0; cell < GRID_SIZE * GRID_SIZE; cell++)
+    {
+        if (bbTest(discovered, cell / GRID_SIZE, cell % GRID_SIZE))
+            continue;
+        if (best < 0 || density[cell] > density[best])
+        {
+            best = cell;
+            ties = 1;
+        }
+        else if (density[cell] == density[best] && rngBounded(rng, ++ties) == 0) // uniform among equals
+        {
+            best = cell;
+        }
+    }
+    return best;
+}
+
+int densityPickSquare(int density[], Rng *rng, int *row, int *col)
+{
+    int bestSum = -1, ties = 0;
+    for (int r = 0; r < GRID_SIZE - 1; r++)
+    {
+        for (int c = 0; c < GRID_SIZE - 1; c++)
+        {
+            int cell = r * GRID_SIZE + c;
+            int sum = density[cell] + density[cell + 1] + density[cell + GRID_SIZE] + density[cell + GRID_SIZE + 1];
+            if (sum > bestSum)
+            {
+                bestSum = sum;
+                ties = 1;
+                *row = r;
+                *col = c;
+            }
+            else if (sum == bestSum && rngBounded(rng, ++ties) == 0)
+            {
+                *row = r;
+                *col = c;
+            }
+        }
+    }
+    return bestSum;
+}
+
+int densityPickLine(int density[], Rng *rng, int *row, int *col)
+{
+    int bestSum = -1, ties = 0;
+    for (int line = 0; line < 2 * GRID_SIZE; line++) // rows, then columns
+    {
+        int sum = 0;
+        for (int i = 0; i < GRID_SIZE; i++)
+            sum += line < GRID_SIZE ? density[line * GRID_SIZE + i] : density[i * GRID_SIZE + line - GRID_SIZE];
+        if (sum > bestSum || (sum == bestSum && rngBounded(rng, ties + 1) == 0))
+        {
+            ties = sum > bestSum ? 1 : ties + 1;
+            bestSum = sum;
+            *row = line < GRID_SIZE ? line : -1;
+            *col = line < GRID_SIZE ? -1 : line - GRID_SIZE;
+        }
+    }
+    return bestSum;
+}
+
+/*-----------------------------------------------------------Monte Carlo Bot----------------------------------------------------------------*/
+
+#define MAX_MONTE_CARLO_THREADS 64
+#define MAX_ATTEMPTS_PER_SAMPLE 1000 // a sample budget alone still ends when the evidence is hard to fit
+#define MONTE_CARLO_SCALE (1 << 20)  // probability 1 in monteCarloMap()
+
+// --mc-samples=<fleets> --mc-ms=<milliseconds> --mc-threads=<threads> set both Monte Carlo budgets,
+// --endgame=<configurations> --endgame-nodes=<states> --endgame-ms=<milliseconds> both endgame ones,
+// --latency records how long every bot move takes
+int parseOptions(int argc, char *argv[])
+{
+    MonteCarloConfig *configs[2] = {&interactiveMonteCarlo, &headlessMonteCarlo};
+    EndgameConfig *endgames[2] = {&interactiveEndgame, &headlessEndgame};
+    int kept = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        for (int c = 0; c < 2; c++)
+        {
+            if (strncmp(argv[i], "--mc-samples=", 13) == 0)
+                configs[c]->samples = atol(argv[i] + 13);
+            else if (strncmp(argv[i], "--mc-ms=", 8) == 0)
+                configs[c]->milliseconds = atoi(argv[i] + 8);
+            else if (strncmp(argv[i], "--mc-threads=", 13) == 0)
+                configs[c]->threads = atoi(argv[i] + 13);
+            else if (strncmp(argv[i], "--endgame=", 10) == 0)
+                endgames[c]->configurations = atoi(argv[i] + 10);
+            else if (strncmp(argv[i], "--endgame-nodes=", 16) == 0)
+                endgames[c]->nodes = atol(argv[i] + 16);
+            else if (strncmp(argv[i], "--endgame-ms=", 13) == 0)
+                endgames[c]->milliseconds = atoi(argv[i] + 13);
+        }
+        if (strcmp(argv[i], "--latency") == 0)
+            recordLatency = 1;
+        else if (strncmp(argv[i], "--record=", 9) == 0)
+            recordPath = argv[i] + 9;
+        else if (strncmp(argv[i], "--tablebase=", 12) == 0)
+            tablebasePath = argv[i] + 12;
+        else if (strncmp(argv[i], "--opening-book=", 15) == 0)
+            openingBookPath = argv[i] + 15;
+        else if (strncmp(argv[i], "--mc-", 5) != 0 && strncmp(argv[i], "--endgame", 9) != 0)
+            argv[kept++] = argv[i];
+    }
+    for (int c = 0; c < 2; c++)
+    {
+        if (configs[c]->samples <= 0 && configs[c]->milliseconds <= 0) // a move has to end somehow
+            configs[c]->samples = headlessMonteCarlo.samples > 0 ? headlessMonteCarlo.samples : 1000;
+        if (endgames[c]->nodes <= 0 && endgames[c]->milliseconds <= 0)
+            endgames[c]->nodes = ENDGAME_NODES;
+    }
+    return kept;
+}
+
+// smoke screens are announced but where they went and what they hid is not. The opponent gets one
+// for every ship of the bot's it sinks, so the ones it has laid are those it does not have left
+int smokeLaid(Player *bot, Player *opponent)
+{
+    return opponent->moves[2].countAvailable < bot->shipsSunk;
+}
+
+// every placement each ship can still have: sunk ships lie on hits only, ships afloat avoid water
+// and are not hit everywhere. Radar contacts are ships; a quiet sweep means water unless the
+// opponent has laid a smoke screen
+int gatherEvidence(Player *bot, Player *opponent, MonteCarloEvidence *evidence)
+{
+    Board *board = &opponent->board;
+    Bitboard water = board->misses;
+    if (!smokeLaid(bot, opponent))
+        water = bbOr(water, bbAndNot(bbAndNot(bot->radaredList->members, bot->foundShips->members), board->hits));
+    evidence->occupied = bbOr(board->hits, bot->foundShips->members);
+    evidence->sunk = 0;
+
+    for (int k = 0; k < SHIPS_COUNT; k++)
+    {
+        int sunk = opponent->ships[k].remainingHits <= 0;
+        evidence->sunk |= sunk << k;
+        evidence->count[k] = 0;
+        for (int p = 0; p < placements.count[k]; p++)
+        {
+            Bitboard cells = placements.mask[k][p];
+            int allHit = !bbAny(bbAndNot(cells, board->hits));
+            evidence->valid[k][p] = !(sunk ? !allHit : (allHit || bbAny(bbAnd(cells, water))));
+            if (evidence->valid[k][p])
+                evidence->placement[k][evidence->count[k]++] = (unsigned char)p;
+        }
+        if (evidence->count[k] == 0)
+            return 0;
+    }
+    return 1;
+}
+
+// importance sampling: known ship cells are covered first, the rest of the fleet is drawn
+// uniformly and dropped on overlap. Weighted by 1 / (probability of the draw), the accepted
+// fleets estimate the uniform distribution over every fleet consistent with the evidence
+double sampleConsistentFleet(MonteCarloEvidence *evidence, Rng *rng, Bitboard *fleet)
+{
+    Bitboard occupied = bbFromBits(0);
+    int placed = evidence->sunk; // bit k: ship k is drawn
+    double weight = 1;
+
+    // sunk ships first, they only have a few placements left
+    for (int k = 0; k < SHIPS_COUNT; k++)
+    {
+        if (!((placed >> k) & 1))
+            continue;
+        Bitboard ship = placements.mask[k][evidence->placement[k][rngBounded(rng, evidence->count[k])]];
+        if (bbAny(bbAnd(occupied, ship)))
+            return 0;
+        occupied = bbOr(occupied, ship);
+        weight *= evidence->count[k];
+    }
+
+    // the lowest known ship cell not covered yet picks among every (ship, placement) through it:
+    // each consistent fleet has exactly one way to be drawn, with probability 1 / weight
+    Bitboard required = bbAndNot(evidence->occupied, occupied);
+    while (bbAny(required))
+    {
+        int cell = bbPopFirst(&required);
+        int choices[SHIPS_COUNT * 2 * MAX_SHIP_SIZE];
+        int n = 0;
+        for (int k = 0; k < SHIPS_COUNT; k++)
+        {
+            if ((placed >> k) & 1)
+                continue;
+            for (int i = 0; i < placements.coverCount[k][cell]; i++)
+            {
+                int p = placements.cover[k][cell][i];
+                if (evidence->valid[k][p] && !bbAny(bbAnd(occupied, placements.mask[k][p])))
+                    choices[n++] = k * MAX_PLACEMENTS + p;
+            }
+        }
+        if (n == 0)
+            return 0;
+
+        int choice = choices[rngBounded(rng, n)];
+        int k = choice / MAX_PLACEMENTS;
+        occupied = bbOr(occupied, placements.mask[k][choice % MAX_PLACEMENTS]);
+        placed |= 1 << k;
+        weight *= n;
+        required = bbAndNot(required, occupied);
+    }
+
+    // the other ships anywhere they may be, largest first, like sampleFleet()
+    for (int k = SHIPS_COUNT - 1; k >= 0; k--)
+    {
+        if ((placed >> k) & 1)
+            continue;
+        Bitboard ship = placements.mask[k][evidence->placement[k][rngBounded(rng, evidence->count[k])]];
+        if (bbAny(bbAnd(occupied, ship)))
+            return 0;
+        occupied = bbOr(occupied, ship);
+        weight *= evidence->count[k];
+    }
+    *fleet = occupied;
+    return weight;
+}
+
+void monteCarloWorkerMain(void *arg)
+{
+    MonteCarloWorker *worker = (MonteCarloWorker *)arg;
+    long maxAttempts = worker->samples * MAX_ATTEMPTS_PER_SAMPLE;
+
+    while (worker->samples == 0 || worker->accepted < worker->samples)
+    {
+        if (worker->deadline > 0 && (worker->attempts & 63) == 0 && wallSeconds() >= worker->deadline)
+            break;
+        if (worker->samples > 0 && worker->attempts >= maxAttempts)
+            break;
+        worker->attempts++;
+        COUNT(counterMonteCarloAttempts, 1);
+
+        Bitboard fleet;
+        double weight = sampleConsistentFleet(worker->evidence, &worker->rng, &fleet);
+        if (weight == 0)
+            continue;
+        worker->accepted++;
+        worker->weight += weight;
+        while (bbAny(fleet))
+            worker->cover[bbPopFirst(&fleet)] += weight;
+    }
+    INSTRUMENT_FLUSH();
+}
+
+// density[cell]: chance of a ship on each undiscovered cell, in 1 / MONTE_CARLO_SCALE, estimated
+// from the fleets sampled within the bot's budget, seeded from rng
+long monteCarloMap(Player *bot, Player *opponent, Rng *rng, int density[])
+{
+    MonteCarloConfig *config = bot->silent ? &headlessMonteCarlo : &interactiveMonteCarlo;
+    MonteCarloEvidence evidence;
+    if (!gatherEvidence(bot, opponent, &evidence))
+        return 0;
+
+    int threads = config->threads > 0 ? config->threads : cpuCount();
+    if (threads > MAX_MONTE_CARLO_THREADS)
+        threads = MAX_MONTE_CARLO_THREADS;
+    if (config->samples > 0 && threads > config->samples)
+        threads = (int)config->samples;
+
+    // the samples are split up front and every thread has its own stream: without a time limit
+    // the same seed gives the same move
+    MonteCarloWorker workers[MAX_MONTE_CARLO_THREADS];
+    Thread handles[MAX_MONTE_CARLO_THREADS];
+    uint64_t seed = rngNext(rng);
+    double deadline = config->milliseconds > 0 ? wallSeconds() + config->milliseconds / 1000.0 : 0;
+    for (int t = 0; t < threads; t++)
+    {
+        memset(&workers[t], 0, sizeof(MonteCarloWorker));
+        workers[t].evidence = &evidence;
+        rngSeed(&workers[t].rng, seed + t);
+        workers[t].samples = config->samples / threads + (t < config->samples % threads);
+        workers[t].deadline = deadline;
+    }
+    for (int t = 1; t < threads; t++)
+        startThread(&handles[t], monteCarloWorkerMain, &workers[t]);
+    monteCarloWorkerMain(&workers[0]); // the calling thread samples too
+    for (int t = 1; t < threads; t++)
+        joinThread(&handles[t]);
+
+    long accepted = 0;
+    double weight = 0;
+    for (int t = 0; t < threads; t++)
+    {
+        accepted += workers[t].accepted;
+        weight += workers[t].weight;
+    }
+    if (accepted == 0)
+        return 0;
+
+    Bitboard discovered = bbOr(opponent->board.hits, opponent->board.misses);
+    for (int cell = 0; cell < GRID_SIZE * GRID_SIZE; cell++)
+    {
+        double cover = 0;
+        for (int t = 0; t < threads; t++)
+            cover += workers[t].cover[cell];
+        density[cell] = bbTest(discovered, cell / GRID_SIZE, cell % GRID_SIZE) ? 0 : (int)(cover / weight * MONTE_CARLO_SCALE + 0.5);
+    }
+    return accepted;
+}
+
+// the target of a move (0: fire, 1: radar, 3: artillery, 4: torpedo) that covers the most likely
+// ship cells. Sampling and ties draw from the observation key, not the game: the target depends on
+// nothing but what the bot knows, so one cached by any thread or game is the target it would pick
+int monteCarloTarget(Player *bot, Player *opponent, int move, int *row, int *col)
+{
+    MonteCarloConfig *config = bot->silent ? &headlessMonteCarlo : &interactiveMonteCarlo;
+    uint64_t budget = (uint64_t)config->samples ^ (uint64_t)config->milliseconds << 40 ^ (uint64_t)config->threads << 56;
+    uint64_t key = observationKey(bot, opponent) ^ zobrist.target[move] ^ splitMix64(&budget);
+    uint64_t data;
+    if (transpositionProbe(key, &data))
+    {
+        *row = (int)(data & 0xFF) - 1;
+        *col = (int)(data >> 8 & 0xFF) - 1;
+        return 1;
+    }
+
+    Rng rng;
+    rngSeed(&rng, key);
+    int density[GRID_SIZE * GRID_SIZE];
+    if (!monteCarloMap(bot, opponent, &rng, density))
+        return 0;
+
+    int score;
+    if (move == 0)
+    {
+        int best = densityPickCell(density, bbOr(opponent->board.hits, opponent->board.misses), &rng);
+        *row = best / GRID_SIZE;
+        *col = best % GRID_SIZE;
+        score = density[best];
+    }
+    else if (move == 4)
+    {
+        score = densityPickLine(density, &rng, row, col);
+    }
+    else
+    {
+        score = densityPickSquare(density, &rng, row, col);
+    }
+    transpositionStore(key, (uint64_t)(*row + 1) | (uint64_t)(*col + 1) << 8 | (uint64_t)(uint32_t)score << 32);
+    return 1;
+}
+
+void monteCarloBestTarget(Player *bot, Player *opponent, int move, int *row, int *col)
+{
+    if (monteCarloTarget(bot, opponent, move, row, col))
+        return;
+    if (move == 0)
+        densityBestCell(bot, opponent, row, col);
+    else if (move == 4)
+        densityBestLine(bot, opponent, row, col);
+    else
+        densityBestSquare(bot, opponent, row, col);
+}
+
+/*---------------------------------------------------------Transposition Table--------------------------------------------------------------*/
+
+// Zobrist hashing: the key of a state is the XOR of the keys of everything true in it, so shots that
+// reach the same knowledge in a different order meet in the same entry
+
+void buildZobristKeys()
+{
+    uint64_t state = 0x5A0B1257ULL; // fixed: keys are the same in every run
+    uint64_t *keys = (uint64_t *)&zobrist;
+    for (size_t i = 0; i < sizeof(ZobristKeys) / sizeof(uint64_t); i++)
+        keys[i] = splitMix64(&state);
+}
+
+// everything the Monte Carlo bot's evidence is made of, and the moves the bot has left
+uint64_t observationKey(Player *bot, Player *opponent)
+{
+    uint64_t key = 0;
+    Board *board = &opponent->board;
+    Bitboard cells = board->hits;
+    while (bbAny(cells))
+        key ^= zobrist.hit[bbPopFirst(&cells)];
+    cells = board->misses;
+    while (bbAny(cells))
+        key ^= zobrist.miss[bbPopFirst(&cells)];
+    cells = bot->radaredList->members;
+    while (bbAny(cells))
+        key ^= zobrist.radared[bbPopFirst(&cells)];
+    cells = bot->foundShips->members;
+    while (bbAny(cells))
+        key ^= zobrist.found[bbPopFirst(&cells)];
+
+    for (int k = 0; k < SHIPS_COUNT; k++)
+    {
+        if (opponent->ships[k].remainingHits <= 0)
+            key ^= zobrist.sunk[k];
+    }
+    for (int m = 1; m < MOVES_COUNT; m++) // fire is never used up
+    {
+        int count = bot->moves[m].countAvailable;
+        key ^= zobrist.available[m][count < 0 ? 0 : count < ZOBRIST_COUNTS ? count : ZOBRIST_COUNTS - 1];
+    }
+    if (smokeLaid(bot, opponent))
+        key ^= zobrist.smoke;
+    return key;
+}
+
+// one entry per slot, the latest store wins. A reader that races a store sees either the old pair,
+// the new pair or a mix, and a mix fails the check: no lock is needed and no wrong data is returned
+int transpositionProbe(uint64_t key, uint64_t *data)
+{
+    PROBE_BEGIN(probeTranspositionProbe);
+    COUNT(counterTranspositionProbes, 1);
+    if (!transpositionEnabled)
+        PROBE_RETURN(probeTranspositionProbe, 0);
+    TranspositionEntry *entry = &transpositionTable[key >> (64 - TRANSPOSITION_BITS)];
+    uint64_t check = atomic_load_explicit(&entry->check, memory_order_relaxed);
+    *data = atomic_load_explicit(&entry->data, memory_order_relaxed);
+    if (*data == 0 || (check ^ *data) != key)
+        PROBE_RETURN(probeTranspositionProbe, 0);
+    COUNT(counterTranspositionHits, 1);
+    PROBE_RETURN(probeTranspositionProbe, 1);
+}
+
+void transpositionStore(uint64_t key, uint64_t data)
+{
+    COUNT(counterTranspositionStores, 1);
+    TranspositionEntry *entry = &transpositionTable[key >> (64 - TRANSPOSITION_BITS)];
+    atomic_store_explicit(&entry->data, data, memory_order_relaxed);
+    atomic_store_explicit(&entry->check, key ^ data, memory_order_relaxed);
+}
+
+/*-----------------------------------------------------------Endgame Solver-----------------------------------------------------------------*/
+
+// with one or two ships afloat and only a few placements of them left, the Master bot stops
+// estimating and searches to the end of the game: every move at every target that can find
+// something, every outcome weighted by the fleets that give it. The move it plays has the fewest
+// expected shots left. Smoke is never searched: it shows nothing, so it can only add a shot
+
+EndgameSolver *createEndgameSolver(Arena *arena)
+{
+    EndgameSolver *solver = (EndgameSolver *)allocate(arena, sizeof(EndgameSolver));
+    memset(solver->memo, 0, sizeof(solver->memo)); // generation 0: empty
+    solver->generation = 0;
+    return solver;
+}
+
+// the tablebase first, it may hold positions too big to solve in a move
+int endgameMove(Player *bot, Player *opponent, int *move, int *row, int *col)
+{
+    EndgameConfig *config = bot->silent ? &headlessEndgame : &interactiveEndgame;
+    if (bot->endgame == NULL || config->configurations <= 0)
+        return 0;
+    int threshold = tablebase.limit > config->configurations ? tablebase.limit : config->configurations;
+    int count = endgameEnumerate(bot->endgame, bot, opponent, threshold);
+    if (count <= 0)
+        return 0;
+    if (tablebase.limit > 0)
+    {
+        int counts[MOVES_COUNT];
+        for (int m = 0; m < MOVES_COUNT; m++)
+            counts[m] = bot->moves[m].countAvailable;
+        if (tablebaseProbe(&tablebase, bot->endgame, opponent->board.hits, counts, move, row, col))
+            return 1;
+    }
+    if (count > config->configurations)
+        return 0;
+    return endgameSolve(bot->endgame, bot, opponent, config, move, row, col);
+}
+
+// every placement of the ships afloat that fits the evidence, weighted by the ways the sunk ships
+// can lie around it. Only the ships afloat are searched, sunk ones are on hits and never found again
+int endgameEnumerate(EndgameSolver *solver, Player *bot, Player *opponent, int threshold)
+{
+    int sunk[SHIPS_COUNT], sunkCount = 0;
+    solver->afloatCount = 0;
+    for (int k = 0; k < SHIPS_COUNT; k++)
+    {
+        if (opponent->ships[k].remainingHits <= 0)
+            sunk[sunkCount++] = k;
+        else if (solver->afloatCount == ENDGAME_SHIPS)
+            return -1;
+        else
+            solver->afloat[solver->afloatCount++] = k;
+    }
+    MonteCarloEvidence evidence;
+    if (solver->afloatCount == 0 || !gatherEvidence(bot, opponent, &evidence))
+        return -1;
+    if (threshold > ENDGAME_MAX_CONFIGS)
+        threshold = ENDGAME_MAX_CONFIGS;
+
+    solver->count = 0;
+    solver->shipsSunk = opponent->shipsSunk;
+    solver->radar = !smokeLaid(bot, opponent);
+    int a = solver->afloat[0];
+    int b = solver->afloatCount == 2 ? solver->afloat[1] : -1;
+    for (int i = 0; i < evidence.count[a]; i++)
+    {
+        Bitboard first = placements.mask[a][evidence.placement[a][i]];
+        for (int j = 0; j < (b < 0 ? 1 : evidence.count[b]); j++)
+        {
+            Bitboard second = b < 0 ? bbFromBits(0) : placements.mask[b][evidence.placement[b][j]];
+            if (bbAny(bbAnd(first, second)))
+                continue;
+            Bitboard fleet = bbOr(first, second);
+            uint32_t weight = endgameCompletions(&evidence, sunk, sunkCount, fleet);
+            if (weight == 0)
+                continue;
+            if (solver->count == threshold)
+                return -1;
+            int c = solver->count++;
+            solver->weight[c] = weight;
+            solver->fleet[c] = fleet;
+            solver->ship[c][0] = first;
+            solver->ship[c][1] = second;
+        }
+    }
+    return solver->count;
+}
+
+uint32_t endgameCompletions(MonteCarloEvidence *evidence, int sunk[], int n, Bitboard occupied)
+{
+    if (n == 0) // every hit and radar contact has to be a ship
+        return !bbAny(bbAndNot(evidence->occupied, occupied));
+
+    uint32_t ways = 0;
+    int k = sunk[0];
+    for (int i = 0; i < evidence->count[k]; i++)
+    {
+        Bitboard ship = placements.mask[k][evidence->placement[k][i]];
+        if (!bbAny(bbAnd(occupied, ship)))
+            ways += endgameCompletions(evidence, sunk + 1, n - 1, bbOr(occupied, ship));
+    }
+    return ways;
+}
+
+int endgameSolve(EndgameSolver *solver, Player *bot, Player *opponent, EndgameConfig *config, int *move, int *row, int *col)
+{
+    solver->nodes = 0;
+    solver->maxNodes = config->nodes;
+    solver->deadline = config->milliseconds > 0 ? wallSeconds() + config->milliseconds / 1000.0 : 0;
+    solver->aborted = 0;
+    if (++solver->generation == 0) // wrapped: old entries could pass for new ones
+    {
+        memset(solver->memo, 0, sizeof(solver->memo));
+        solver->generation = 1;
+    }
+
+    uint64_t subset[ENDGAME_WORDS] = {0};
+    for (int c = 0; c < solver->count; c++)
+        subset[c / 64] |= 1ULL << (c % 64);
+    int counts[MOVES_COUNT];
+    for (int m = 0; m < MOVES_COUNT; m++)
+        counts[m] = bot->moves[m].countAvailable;
+
+    int best[3];
+    double value = endgameSearch(solver, subset, opponent->board.hits, counts, opponent->shipsSunk, HUGE_VAL, best);
+    if (solver->aborted)
+        return 0;
+    *move = best[0];
+    *row = best[1];
+    *col = best[2];
+    solver->expected = value;
+    return 1;
+}
+
+// the moves left after a move and its sinks: makeMove() uses the move up, updateGameState() unlocks
+// more with every sink
+int endgameCounts(int counts[], int move, int sinks, int shipsSunk, int next[])
+{
+    memcpy(next, counts, sizeof(int) * MOVES_COUNT);
+    if (next[move] > 0)
+        next[move]--;
+    for (; sinks != 0; sinks &= sinks - 1)
+    {
+        shipsSunk++;
+        for (int m = 0; m < MOVES_COUNT; m++)
+        {
+            if (moveUnlockThresholds[m] <= shipsSunk && next[m] >= 0)
+                next[m]++;
+        }
+    }
+    return shipsSunk;
+}
+
+// the shots it takes to hit cells more ship cells if every torpedo and artillery strike hit all it
+// can (a ship afloat has at most 5 cells left in one line). Every sink but the last may unlock more
+int endgameLowerBound(int cells, int afloat, int counts[], int shipsSunk)
+{
+    int torpedoes = counts[4], artilleries = counts[3];
+    for (int sunk = shipsSunk + 1; sunk < shipsSunk + afloat; sunk++)
+    {
+        torpedoes += moveUnlockThresholds[4] <= sunk && counts[4] >= 0;
+        artilleries += moveUnlockThresholds[3] <= sunk && counts[3] >= 0;
+    }
+    int shots = 0;
+    for (; cells > 0 && torpedoes > 0; torpedoes--, shots++)
+        cells -= afloat * MAX_SHIP_SIZE;
+    for (; cells > 0 && artilleries > 0; artilleries--, shots++)
+        cells -= 4;
+    return shots + (cells > 0 ? cells : 0);
+}
+
+// expected shots of a move: 1, plus those of every outcome that does not end the game. Stops as
+// soon as it cannot beat bound, the value returned is then only known to be at least bound
+double endgameAction(EndgameSolver *solver, uint64_t subset[], double total, Bitboard hits, int counts[], int shipsSunk,
+                     int move, Bitboard target, double bound)
+{
+    unsigned char outcome[ENDGAME_MAX_CONFIGS]; // of each configuration
+    Bitboard found[ENDGAME_MAX_CONFIGS];        // of each outcome: new hits, or radar contacts
+    int sinks[ENDGAME_MAX_CONFIGS];             // bit j: afloat[j] sinks
+    double weight[ENDGAME_MAX_CONFIGS];
+    int first[ENDGAME_MAX_CONFIGS];             // a configuration that gives it
+    int outcomes = 0;
+
+    for (int w = 0; w < ENDGAME_WORDS; w++)
+    {
+        uint64_t bits = subset[w];
+        while (bits != 0)
+        {
+            int c = w * 64 + lowestBit64(bits);
+            bits &= bits - 1;
+            Bitboard cells = bbAnd(bbAndNot(target, hits), solver->fleet[c]);
+            int sink = 0;
+            for (int j = 0; move != 1 && j < solver->afloatCount; j++)
+            {
+                Bitboard ship = solver->ship[c][j];
+                if (bbAny(bbAndNot(ship, hits)) && !bbAny(bbAndNot(ship, bbOr(hits, cells))))
+                    sink |= 1 << j;
+            }
+            int o = 0;
+            while (o < outcomes && !(found[o].lo == cells.lo && found[o].hi == cells.hi && sinks[o] == sink))
+                o++;
+            if (o == outcomes)
+            {
+                found[o] = cells;
+                sinks[o] = sink;
+                weight[o] = 0;
+                first[o] = c;
+                outcomes++;
+            }
+            outcome[c] = (unsigned char)o; // no more outcomes than configurations
+            weight[o] += solver->weight[c];
+        }
+    }
+    if (outcomes == 1 && (move == 1 || !bbAny(found[0]))) // nothing learned, nothing hit
+        return bound;
+
+    // every outcome that leaves a ship afloat costs its lower bound at least, see endgameLowerBound()
+    int terminal[ENDGAME_MAX_CONFIGS];
+    double bounds[ENDGAME_MAX_CONFIGS];
+    double value = 1;
+    for (int o = 0; o < outcomes; o++)
+    {
+        int afloat = 0, cells = GRID_SIZE * GRID_SIZE;
+        Bitboard known = move == 1 ? hits : bbOr(hits, found[o]);
+        for (int j = 0; j < solver->afloatCount; j++)
+            afloat += bbAny(bbAndNot(solver->ship[first[o]][j], known));
+        terminal[o] = afloat == 0;
+        if (terminal[o])
+            continue;
+        for (int c = first[o]; c < solver->count; c++) // the fewest ship cells left of any of its configurations
+        {
+            if (outcome[c] == o && ((subset[c / 64] >> (c % 64)) & 1))
+            {
+                int left = bbCount(bbAndNot(solver->fleet[c], known));
+                cells = left < cells ? left : cells;
+            }
+        }
+        int next[MOVES_COUNT];
+        int sunk = endgameCounts(counts, move, sinks[o], shipsSunk, next);
+        bounds[o] = endgameLowerBound(cells, afloat, next, sunk);
+        value += weight[o] / total * bounds[o];
+    }
+
+    for (int o = 0; o < outcomes && value < bound; o++)
+    {
+        if (terminal[o])
+            continue;
+        uint64_t child[ENDGAME_WORDS];
+        for (int w = 0; w < ENDGAME_WORDS; w++)
+        {
+            child[w] = 0;
+            uint64_t bits = subset[w];
+            while (bits != 0)
+            {
+                int b = lowestBit64(bits);
+                bits &= bits - 1;
+                if (outcome[w * 64 + b] == o)
+                    child[w] |= 1ULL << b;
+            }
+        }
+
+        int next[MOVES_COUNT];
+        int sunk = endgameCounts(counts, move, sinks[o], shipsSunk, next);
+        // the most this outcome may cost for the move to still beat bound
+        double limit = bounds[o] + (bound - value) * total / weight[o];
+        double expected = endgameSearch(solver, child, move == 1 ? hits : bbOr(hits, found[o]), next, sunk, limit, NULL);
+        if (solver->aborted || expected >= limit) // the sum below could round to just under bound
+            return bound;
+        value += weight[o] / total * (expected - bounds[o]);
+    }
+    return value;
+}
+
+// fewest expected shots to sink the ships afloat, given the configurations left, the hits and the
+// moves at hand. Exact below bound; otherwise only known to be at least bound, which is all the
+// caller needs. best: the move (and its row and col, torpedo: one of them -1) at the root
+double endgameSearch(EndgameSolver *solver, uint64_t subset[], Bitboard hits, int counts[], int shipsSunk, double bound, int best[3])
+{
+    uint32_t packed = (uint32_t)(counts[1] < 15 ? counts[1] : 15) | (uint32_t)(counts[3] < 15 ? counts[3] : 15) << 4 |
+                      (uint32_t)(counts[4] < 15 ? counts[4] : 15) << 8;
+    uint64_t hash = hits.lo * 0x9E3779B97F4A7C15ULL ^ hits.hi * 0xC2B2AE3D27D4EB4FULL ^ packed;
+    for (int w = 0; w < ENDGAME_WORDS; w++)
+        hash = (hash ^ subset[w]) * 0xFF51AFD7ED558CCDULL;
+    EndgameEntry *entry = &solver->memo[splitMix64(&hash) >> (64 - ENDGAME_MEMO_BITS)];
+    if (best == NULL && entry->generation == solver->generation && (entry->counts & ~ENDGAME_LOWER) == packed &&
+        entry->hits.lo == hits.lo && entry->hits.hi == hits.hi && memcmp(entry->subset, subset, sizeof(entry->subset)) == 0)
+    {
+        if (!(entry->counts & ENDGAME_LOWER) || entry->expected >= bound)
+            return entry->expected;
+    }
+
+    solver->nodes++;
+    if ((solver->maxNodes > 0 && solver->nodes > solver->maxNodes) ||
+        (solver->deadline > 0 && (solver->nodes & 255) == 0 && wallSeconds() >= solver->deadline))
+    {
+        solver->aborted = 1;
+        return 0;
+    }
+
+    // cells where a ship may still be found, the likelier first: good moves early cut the rest short
+    double total = 0;
+    double cover[GRID_SIZE * GRID_SIZE] = {0};
+    for (int w = 0; w < ENDGAME_WORDS; w++)
+    {
+        uint64_t bits = subset[w];
+        while (bits != 0)
+        {
+            int c = w * 64 + lowestBit64(bits);
+            bits &= bits - 1;
+            total += solver->weight[c];
+            Bitboard cells = bbAndNot(solver->fleet[c], hits);
+            while (bbAny(cells))
+                cover[bbPopFirst(&cells)] += solver->weight[c];
+        }
+    }
+    Bitboard open = bbFromBits(0);
+    int order[GRID_SIZE * GRID_SIZE], cells = 0;
+    for (int cell = 0; cell < GRID_SIZE * GRID_SIZE; cell++)
+    {
+        if (cover[cell] == 0)
+            continue;
+        open = bbOr(open, bbCell(cell / GRID_SIZE, cell % GRID_SIZE));
+        int i = cells++;
+        while (i > 0 && cover[order[i - 1]] < cover[cell])
+        {
+            order[i] = order[i - 1];
+            i--;
+        }
+        order[i] = cell;
+    }
+
+    // torpedoes and artillery first, they find the most in one shot; radar last
+    double bestValue = bound;
+    for (int stage = 0; stage < 4 && !solver->aborted; stage++)
+    {
+        int move = stage == 0 ? 4 : stage == 1 ? 3 : stage == 2 ? 0 : 1;
+        if (move != 0 && counts[move] <= 0)
+            continue;
+        if (move == 1 && !solver->radar)
+            continue;
+        int targets = move == 4 ? 2 * GRID_SIZE : move == 0 ? cells : (GRID_SIZE - 1) * (GRID_SIZE - 1);
+        for (int i = 0; i < targets && !solver->aborted; i++)
+        {
+            int row, col;
+            Bitboard target;
+            if (move == 4)
+            {
+                row = i < GRID_SIZE ? i : -1;
+                col = i < GRID_SIZE ? -1 : i - GRID_SIZE;
+                target = col == -1 ? bbRow(row) : bbColumn(col);
+            }
+            else if (move == 0)
+            {
+                row = order[i] / GRID_SIZE;
+                col = order[i] % GRID_SIZE;
+                target = bbCell(row, col);
+            }
+            else
+            {
+                row = i / (GRID_SIZE - 1);
+                col = i % (GRID_SIZE - 1);
+                target = bbSquare(row, col);
+            }
+            if (!bbAny(bbAnd(target, open)))
+                continue;
+
+            double value = endgameAction(solver, subset, total, hits, counts, shipsSunk, move, target, bestValue);
+            if (value < bestValue && !solver->aborted)
+            {
+                bestValue = value;
+                if (best != NULL)
+                {
+                    best[0] = move;
+                    best[1] = row;
+                    best[2] = col;
+                }
+            }
+        }
+    }
+    if (solver->aborted)
+        return 0;
+
+    entry->generation = solver->generation;
+    memcpy(entry->subset, subset, sizeof(entry->subset));
+    entry->hits = hits;
+    entry->counts = packed | (bestValue < bound ? 0 : ENDGAME_LOWER);
+    entry->expected = bestValue;
+    return bestValue;
+}
+
+/*-------------------------------------------------------------Tablebase--------------------------------------------------------------------*/
+
+// optimal endgame moves solved offline by --build-tablebase, for positions past what a move can
+// afford to solve. A position is keyed by what the solver sees: the configurations, the hits on
+// them and the moves left; the grid's 8 rotations and reflections share one key and one entry,
+// the move is stored turned the same way. The file is an open-addressed table, mapped read-only:
+// a probe touches one or two pages, the rest of the file is never read
+
+// symmetry bits: 4 transposes, then 1 mirrors the rows and 2 the columns
+void buildSymmetries()
+{
+    for (int s = 0; s < SYMMETRIES; s++)
+    {
+        for (int cell = 0; cell < GRID_SIZE * GRID_SIZE; cell++)
+        {
+            int row = cell / GRID_SIZE, col = cell % GRID_SIZE;
+            if (s & 4)
+            {
+                int swap = row;
+                row = col;
+                col = swap;
+            }
+            if (s & 1)
+                row = GRID_SIZE - 1 - row;
+            if (s & 2)
+                col = GRID_SIZE - 1 - col;
+            symmetryCell[s][cell] = (unsigned char)(row * GRID_SIZE + col);
+        }
+    }
+    for (int s = 0; s < SYMMETRIES; s++)
+    {
+        for (int t = 0; t < SYMMETRIES; t++)
+        {
+            int cell = 0;
+            while (cell < GRID_SIZE * GRID_SIZE && symmetryCell[t][symmetryCell[s][cell]] == cell)
+                cell++;
+            if (cell == GRID_SIZE * GRID_SIZE)
+                inverseSymmetry[s] = t;
+        }
+    }
+}
+
+Bitboard bbTransform(Bitboard b, int symmetry)
+{
+    Bitboard result = bbFromBits(0);
+    while (bbAny(b))
+    {
+        int cell = symmetryCell[symmetry][bbPopFirst(&b)];
+        result = bbOr(result, bbCell(cell / GRID_SIZE, cell % GRID_SIZE));
+    }
+    return result;
+}
+
+Bitboard moveTarget(int move, int row, int col)
 {
-    Player bot = createPlayer();
-    strcpy(bot.name, "Bot");
-    bot.isBot = 1;               // Mark as bot
-    bot.difficulty = difficulty; // Set bot difficulty
-    // No need to allocate grid again since createPlayer() already does it
-    bot.botsShipsCoord = createList();
-    bot.botHitList = createList();
-    bot.radaredList = createList();
-    bot.foundShips = createList();
-    return bot;
+    if (move == 0)
+        return bbCell(row, col);
+    if (move == 4)
+        return col == -1 ? bbRow(row) : bbColumn(col);
+    return bbSquare(row, col);
 }
 
-Ship *createShips()
+// a square's top-left and a row's first cell are the lowest cells they cover, turned or not
+void transformMove(int move, int *row, int *col, int symmetry)
 {
-    Ship *ships = (Ship *)malloc(sizeof(Ship) * SHIPS_COUNT);
-    if (ships == NULL)
+    Bitboard target = bbTransform(moveTarget(move, *row, *col), symmetry);
+    int first = bbPopFirst(&target);
+    *row = first / GRID_SIZE;
+    *col = first % GRID_SIZE;
+    if (move == 4)
     {
-        printf("Failed to allocate needed memory\n");
-        exit(1);
+        if (bbAny(bbAnd(target, bbRow(*row))))
+            *col = -1;
+        else
+            *row = -1;
     }
-    for (int i = 2; i <= 5; i++)
+}
+
+// configurations are summed, so the order endgameEnumerate() found them in does not matter. Hits
+// off every configuration change nothing the solver sees, they are left out
+uint64_t endgameKey(EndgameSolver *solver, Bitboard hits, int counts[], int symmetry)
+{
+    const unsigned char *cell = symmetryCell[symmetry];
+    Bitboard open = bbFromBits(0);
+    uint64_t key = 0;
+    for (int c = 0; c < solver->count; c++)
     {
-        strcpy(ships[i - 2].name, getShipName(i));
-        ships[i - 2].remainingHits = i;
+        uint64_t term = solver->weight[c];
+        for (int j = 0; j < solver->afloatCount; j++)
+        {
+            Bitboard cells = solver->ship[c][j];
+            while (bbAny(cells))
+                term ^= (j == 0 ? zobrist.found : zobrist.radared)[cell[bbPopFirst(&cells)]];
+        }
+        key += splitMix64(&term);
+        open = bbOr(open, solver->fleet[c]);
     }
-    return ships;
+    Bitboard known = bbAnd(hits, open);
+    while (bbAny(known))
+        key ^= zobrist.hit[cell[bbPopFirst(&known)]];
+    for (int m = 1; m < MOVES_COUNT; m++)
+    {
+        if (m == 2) // smoke is never searched
+            continue;
+        int count = counts[m];
+        key ^= zobrist.available[m][count < 0 ? 0 : count < ZOBRIST_COUNTS ? count : ZOBRIST_COUNTS - 1];
+    }
+    key ^= zobrist.sunk[solver->shipsSunk < SHIPS_COUNT ? solver->shipsSunk : SHIPS_COUNT - 1];
+    if (!solver->radar)
+        key ^= zobrist.smoke;
+    return key != 0 ? key : 1; // 0 marks an empty slot
 }
 
-Move *createMoves()
+uint64_t canonicalEndgameKey(EndgameSolver *solver, Bitboard hits, int counts[], int *symmetry)
 {
-    Move *moves = (Move *)malloc(sizeof(Move) * MOVES_COUNT);
-    if (moves == NULL)
+    uint64_t best = endgameKey(solver, hits, counts, 0);
+    *symmetry = 0;
+    for (int s = 1; s < SYMMETRIES; s++)
     {
-        printf("Failed to allocate needed memory\n");
+        uint64_t key = endgameKey(solver, hits, counts, s);
+        if (key < best)
+        {
+            best = key;
+            *symmetry = s;
+        }
+    }
+    return best;
+}
+
+int openTablebase(Tablebase *table, const char *path, const char *magic)
+{
+    memset(table, 0, sizeof(Tablebase));
+    if (!mapFile(&table->map, path, MADV_RANDOM)) // probes land anywhere, reading ahead only wastes memory
+        return 0;
+    const unsigned char *header = table->map.data;
+    if (table->map.size < TABLEBASE_HEADER || memcmp(header, magic, 8) != 0 || header[8] != TABLEBASE_VERSION ||
+        header[10] > 30 || table->map.size != TABLEBASE_HEADER + ((size_t)TABLEBASE_SLOT << header[10]))
+    {
+        closeTablebase(table);
+        return 0;
+    }
+    table->limit = header[9];
+    table->bits = header[10];
+    table->entries = (long)header[12] | (long)header[13] << 8 | (long)header[14] << 16 | (long)header[15] << 24;
+    return 1;
+}
+
+void closeTablebase(Tablebase *table)
+{
+    unmapFile(&table->map);
+    memset(table, 0, sizeof(Tablebase));
+}
+
+const unsigned char *tablebaseFind(Tablebase *table, uint64_t key)
+{
+    size_t mask = ((size_t)1 << table->bits) - 1;
+    size_t index = (size_t)(key >> (64 - table->bits));
+    for (size_t probes = 0; probes <= mask; probes++, index = (index + 1) & mask)
+    {
+        const unsigned char *slot = table->map.data + TABLEBASE_HEADER + index * TABLEBASE_SLOT;
+        uint64_t stored = 0;
+        for (int b = 7; b >= 0; b--)
+            stored = stored << 8 | slot[b];
+        if (stored == 0)
+            return NULL;
+        if (stored == key)
+            return slot;
+    }
+    return NULL;
+}
+
+// solver holds the position's configurations, from endgameEnumerate()
+int tablebaseProbe(Tablebase *table, EndgameSolver *solver, Bitboard hits, int counts[], int *move, int *row, int *col)
+{
+    COUNT(counterTablebaseProbes, 1);
+    int symmetry;
+    const unsigned char *slot = tablebaseFind(table, canonicalEndgameKey(solver, hits, counts, &symmetry));
+    if (slot == NULL)
+        return 0;
+    *move = slot[12];
+    *row = slot[13] - 1;
+    *col = slot[14] - 1;
+    transformMove(*move, row, col, inverseSymmetry[symmetry]);
+    COUNT(counterTablebaseHits, 1);
+    return 1;
+}
+
+TablebaseEntry *tablebaseSlot(TablebaseEntry entries[], int bits, uint64_t key)
+{
+    size_t mask = ((size_t)1 << bits) - 1;
+    size_t index = (size_t)(key >> (64 - bits));
+    while (entries[index].key != 0 && entries[index].key != key) // never full, see tablebaseSolve()
+        index = (index + 1) & mask;
+    return &entries[index];
+}
+
+// every position is solved once per worker, the ones over budget are remembered too. A worker meets
+// its games in order, so an entry is from the first time the worker met its position
+void tablebaseSolve(TablebaseWorker *worker, Player *player, Player *opponent, long met)
+{
+    int counts[MOVES_COUNT];
+    for (int m = 0; m < MOVES_COUNT; m++)
+        counts[m] = player->moves[m].countAvailable;
+    int symmetry;
+    uint64_t key = canonicalEndgameKey(worker->solver, opponent->board.hits, counts, &symmetry);
+    TablebaseEntry *entry = tablebaseSlot(worker->entries, TABLEBASE_WORKER_BITS, key);
+    if (entry->key == key)
+        return;
+    if (2 * (worker->count + 1) > 1 << TABLEBASE_WORKER_BITS) // dropping positions would make the file depend on the thread count
+    {
+        printf("Too many endgame positions per thread: use more threads or fewer games\n");
         exit(1);
     }
-    const char *names[MOVES_COUNT] = {"FIRE", "RADAR SWEEP", "SMOKE SCREEN", "ARTILLERY", "TORPEDO"};
-    int counts[MOVES_COUNT] = {-1, 3, 0, 0, 0};
-    const int valueToUnlock[MOVES_COUNT] = {0, 0, 1, 1, 3};
 
-    for (int i = 0; i < MOVES_COUNT; i++)
+    int move, row, col;
+    entry->key = key;
+    entry->move = TABLEBASE_UNSOLVED;
+    entry->met = met;
+    worker->count++;
+    if (endgameSolve(worker->solver, player, opponent, &worker->config, &move, &row, &col))
     {
-        strcpy(moves[i].name, names[i]);
-        moves[i].countAvailable = counts[i];
-        moves[i].shipsSunkToUnlock = valueToUnlock[i];
+        transformMove(move, &row, &col, symmetry);
+        entry->move = (unsigned char)move;
+        entry->row = (signed char)row;
+        entry->col = (signed char)col;
+        entry->expected = (uint32_t)(worker->solver->expected * 1000 + 0.5);
+        worker->solved++;
     }
-    return moves;
 }
 
-CellList *createList()
+// Master against Master: the positions the bots reading the tablebase get into. Games are dealt
+// round-robin, so every position is met whatever the thread count
+void tablebaseWorkerMain(void *arg)
+{
+    TablebaseWorker *worker = (TablebaseWorker *)arg;
+    Rng rng;
+    for (long g = worker->id; g < worker->games; g += worker->workerCount)
+    {
+        rngSeed(&rng, gameSeed(worker->seed, 0, g));
+        arenaReset(&worker->arena);
+        Player players[2] = {createBotPlayer(monteCarloBot, &worker->arena), createBotPlayer(monteCarloBot, &worker->arena)};
+        players[0].silent = players[1].silent = 1;
+        players[0].rng = players[1].rng = &rng;
+        placeShips(&players[0]);
+        placeShips(&players[1]);
+
+        for (int t = 0; t < MAX_HEADLESS_TURNS && players[0].shipsSunk < SHIPS_COUNT && players[1].shipsSunk < SHIPS_COUNT; t++)
+        {
+            Player *player = &players[t % 2];
+            Player *opponent = &players[1 - t % 2];
+            if (endgameEnumerate(worker->solver, player, opponent, worker->config.configurations) > 0)
+            {
+                worker->positions++;
+                tablebaseSolve(worker, player, opponent, g * MAX_HEADLESS_TURNS + t);
+            }
+            if (makeMove(player, opponent))
+                updateGameState(opponent, player);
+        }
+        freeAll(&players[0]);
+        freeAll(&players[1]);
+    }
+    INSTRUMENT_FLUSH();
+    if (recordLatency)
+        latencyFlush();
+}
+
+// by key, then by when the position was met: a key met in several orientations can be solved to
+// different moves, and one thread keeps the first. The rest only makes the order total
+int compareTablebaseEntries(const void *a, const void *b)
+{
+    const TablebaseEntry *x = (const TablebaseEntry *)a, *y = (const TablebaseEntry *)b;
+    if (x->key != y->key)
+        return x->key < y->key ? -1 : 1;
+    if (x->met != y->met)
+        return x->met < y->met ? -1 : 1;
+    if (x->move != y->move)
+        return x->move < y->move ? -1 : 1;
+    if (x->row != y->row)
+        return x->row < y->row ? -1 : 1;
+    if (x->col != y->col)
+        return x->col < y->col ? -1 : 1;
+    return x->expected < y->expected ? -1 : x->expected > y->expected;
+}
+
+int runBuildTablebase(int argc, char *argv[])
 {
-    CellList *list = (CellList *)malloc(sizeof(CellList));
-    if (list == NULL)
+    const char *path = argv[2];
+    long games = atol(argv[3]);
+    int threads = cpuCount();
+    uint64_t seed = (uint64_t)time(NULL);
+    EndgameConfig config = {TABLEBASE_CONFIGURATIONS, TABLEBASE_NODES, 0};
+    for (int i = 4; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--seed=", 7) == 0)
+            seed = strtoull(argv[i] + 7, NULL, 10);
+        else if (strncmp(argv[i], "--configurations=", 17) == 0)
+            config.configurations = atoi(argv[i] + 17);
+        else if (strncmp(argv[i], "--nodes=", 8) == 0)
+            config.nodes = atol(argv[i] + 8);
+        else
+            threads = atoi(argv[i]);
+    }
+    if (games <= 0 || threads <= 0 || config.configurations <= 0 || config.configurations > 255 || config.nodes <= 0) // one byte in the header
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    TablebaseWorker *workers = (TablebaseWorker *)calloc(threads, sizeof(TablebaseWorker));
+    countAllocation();
+    if (workers == NULL)
+    {
+        printf("Failed to allocate needed memory\n");
+        exit(1);
+    }
+    for (int w = 0; w < threads; w++)
+    {
+        workers[w].id = w;
+        workers[w].workerCount = threads;
+        workers[w].games = games;
+        workers[w].seed = seed;
+        workers[w].config = config;
+        workers[w].arena = createArena(GAME_ARENA_BYTES);
+        workers[w].solver = createEndgameSolver(NULL);
+    }
+
+    double start = wallSeconds();
+    runWorkers(threads, tablebaseWorkerMain, workers, sizeof(TablebaseWorker));
+    double seconds = wallSeconds() - start;
+
+    // workers meet the same positions: keep the one met first, as a single thread would, in key order
+    long positions = 0, count = 0, unsolved = 0;
+    for (int w = 0; w < threads; w++)
+    {
+        positions += workers[w].positions;
+        count += workers[w].count;
+    }
+    TablebaseEntry *entries = (TablebaseEntry *)malloc(sizeof(TablebaseEntry) * (count + 1));
+    countAllocation();
+    if (entries == NULL)
     {
         printf("Failed to allocate needed memory\n");
         exit(1);
     }
-    list->head = NULL;
-    return list;
+    count = 0;
+    for (int w = 0; w < threads; w++)
+    {
+        for (int i = 0; i < 1 << TABLEBASE_WORKER_BITS; i++)
+        {
+            if (workers[w].entries[i].key != 0)
+                entries[count++] = workers[w].entries[i];
+        }
+    }
+    qsort(entries, count, sizeof(TablebaseEntry), compareTablebaseEntries);
+    long unique = 0;
+    for (long i = 0; i < count; i++)
+    {
+        if (i > 0 && entries[i].key == entries[i - 1].key) // met later
+            continue;
+        if (entries[i].move == TABLEBASE_UNSOLVED)
+            unsolved++;
+        else
+            entries[unique++] = entries[i];
+    }
+
+    int written = writeTablebase(path, TABLEBASE_MAGIC, config.configurations, entries, unique);
+    if (!written)
+        printf("Cannot create %s\n", path);
+    else
+    {
+        double expected = 0;
+        for (long i = 0; i < unique; i++)
+            expected += entries[i].expected / 1000.0;
+        printf("seed: %llu\n", (unsigned long long)seed);
+        printf("games: %ld, endgame positions: %ld, distinct: %ld, over %ld states: %ld\n", games, positions, unique + unsolved,
+               config.nodes, unsolved);
+        printf("%s: %ld entries of at most %d configurations, %.2f shots left on average\n", path, unique,
+               config.configurations, unique > 0 ? expected / unique : 0.0);
+        printf("%.3f s on %d threads\n", seconds, threads);
+    }
+
+    for (int w = 0; w < threads; w++)
+    {
+        freeArena(&workers[w].arena);
+        free(workers[w].solver);
+    }
+    free(entries);
+    free(workers);
+    return !written;
 }
 
-int **createGrid()
+// header, then 2^bits slots at most half full: probes for missing keys stop early. Slots are
+// filled in the order of entries, the same entries in the same order give the same file
+int writeTablebase(const char *path, const char *magic, int limit, TablebaseEntry entries[], long count)
 {
-    int **grid;
-    grid = (int **)malloc(sizeof(int *) * GRID_SIZE);
-    if (grid == NULL)
+    int bits = 4;
+    while (((long)1 << bits) < 2 * count)
+        bits++;
+    size_t size = TABLEBASE_HEADER + ((size_t)TABLEBASE_SLOT << bits);
+    unsigned char *file = (unsigned char *)calloc(size, 1);
+    countAllocation();
+    if (file == NULL)
     {
         printf("Failed to allocate needed memory\n");
         exit(1);
     }
-    for (int i = 0; i < GRID_SIZE; i++)
+    memcpy(file, magic, 8);
+    file[8] = TABLEBASE_VERSION;
+    file[9] = (unsigned char)limit;
+    file[10] = (unsigned char)bits;
+    for (int b = 0; b < 4; b++)
+        file[12 + b] = (unsigned char)(count >> (8 * b));
+    size_t mask = ((size_t)1 << bits) - 1;
+    for (long i = 0; i < count; i++)
     {
-        grid[i] = (int *)malloc(sizeof(int) * GRID_SIZE);
-        if (grid[i] == NULL)
+        size_t index = (size_t)(entries[i].key >> (64 - bits));
+        unsigned char *slot = file + TABLEBASE_HEADER + index * TABLEBASE_SLOT;
+        while (slot[0] | slot[1] | slot[2] | slot[3] | slot[4] | slot[5] | slot[6] | slot[7]) // no key is 0
         {
-            printf("Failed to allocate needed memory\n");
-            // free what have already been allocated:
-            for (int j = 0; j < i; j++)
-                free(grid[j]);
-            free(grid);
-            exit(1);
+            index = (index + 1) & mask;
+            slot = file + TABLEBASE_HEADER + index * TABLEBASE_SLOT;
         }
+        for (int b = 0; b < 8; b++)
+            slot[b] = (unsigned char)(entries[i].key >> (8 * b));
+        for (int b = 0; b < 4; b++)
+            slot[8 + b] = (unsigned char)(entries[i].expected >> (8 * b));
+        slot[12] = entries[i].move;
+        slot[13] = (unsigned char)(entries[i].row + 1);
+        slot[14] = (unsigned char)(entries[i].col + 1);
     }
-    for (int i = 0; i < GRID_SIZE; i++)
+
+    FILE *out = fopen(path, "wb");
+    int written = out != NULL && fwrite(file, 1, size, out) == size;
+    if (out != NULL && fclose(out) != 0)
+        written = 0;
+    free(file);
+    return written;
+}
+
+/*------------------------------------------------------------Opening Book------------------------------------------------------------------*/
+
+// the Hard bot's first shots, worked out offline by --build-opening-book. Until its first hit the
+// bot has only seen misses, so the misses are the whole position, and after a miss the book's
+// next shot follows from the last one: a book is one line of --depth shots. Each shot is the one
+// after which the bot wins fastest, played out against fleets placed like botPlaceFleet() does
+// (uniform) and like the human model (no two ships side by side). The file is a tablebase, keyed
+// by the misses up to the grid's symmetries
+
+uint64_t openingKey(Bitboard misses, int symmetry)
+{
+    uint64_t key = 0;
+    while (bbAny(misses))
+        key ^= zobrist.miss[symmetryCell[symmetry][bbPopFirst(&misses)]];
+    return key != 0 ? key : 1; // 0 marks an empty slot
+}
+
+uint64_t canonicalOpeningKey(Bitboard misses, int *symmetry)
+{
+    uint64_t best = openingKey(misses, 0);
+    *symmetry = 0;
+    for (int s = 1; s < SYMMETRIES; s++)
     {
-        for (int j = 0; j < GRID_SIZE; j++)
+        uint64_t key = openingKey(misses, s);
+        if (key < best)
         {
-            grid[i][j] = -1;
+            best = key;
+            *symmetry = s;
         }
     }
-    return grid;
+    return best;
 }
 
-void displayGrid(Player *player)
+int openingMove(Tablebase *book, Board *board, int *row, int *col)
 {
-    printf("   A B C D E F G H I J\n");
-    for (int i = 0; i < GRID_SIZE; i++)
+    if (bbAny(board->hits) || bbCount(board->misses) >= book->limit)
+        return 0;
+    COUNT(counterOpeningProbes, 1);
+    int symmetry;
+    const unsigned char *slot = tablebaseFind(book, canonicalOpeningKey(board->misses, &symmetry));
+    if (slot == NULL)
+        return 0;
+    int bookRow = slot[13] - 1, bookCol = slot[14] - 1;
+    transformMove(0, &bookRow, &bookCol, inverseSymmetry[symmetry]);
+    if (isDiscovered(board, bookRow, bookCol)) // only a key collision gets here
+        return 0;
+    *row = bookRow;
+    *col = bookCol;
+    COUNT(counterOpeningHits, 1);
+    return 1;
+}
+
+// every ship uniform over the placements that avoid the misses, redrawn on overlap: uniform over
+// the fleets that fit. The ones with no two ships touching are uniform over the human model's
+int sampleOpeningFleet(MonteCarloEvidence *evidence, Rng *rng, Fleet *fleet)
+{
+    Bitboard occupied = bbFromBits(0), around = bbFromBits(0);
+    int spread = 1;
+    for (int k = SHIPS_COUNT - 1; k >= 0; k--) // largest first, like sampleFleet()
     {
-        printf("%2d", i + 1);
-        for (int j = 0; j < GRID_SIZE; j++)
+        if (evidence->count[k] == 0) // the misses leave this ship nowhere
+            return 0;
+        int p = evidence->placement[k][rngBounded(rng, evidence->count[k])];
+        Bitboard ship = placements.mask[k][p];
+        if (bbAny(bbAnd(occupied, ship)))
+            return 0;
+        if (bbAny(bbAnd(around, ship)))
+            spread = 0;
+        occupied = bbOr(occupied, ship);
+        around = bbOr(around, bbNeighbours(ship));
+        fleet->placement[k] = (unsigned char)p;
+    }
+    return 1 + spread;
+}
+
+// the bot's turns, this shot included, against an opponent who never shoots back. The misses are
+// water in every fleet drawn, so they are simply marked
+int openingRollout(Arena *arena, Fleet *fleet, Bitboard misses, int cell, uint64_t seed)
+{
+    Rng rng;
+    rngSeed(&rng, seed);
+    arenaReset(arena);
+    Player bot = createBotPlayer(hardBot, arena);
+    Player opponent = createBotPlayer(hardBot, arena);
+    bot.silent = opponent.silent = 1;
+    bot.rng = opponent.rng = &rng;
+    bot.openingBook = NULL; // a book read with --opening-book must not steer the one being built
+    placeFleet(&opponent, fleet);
+    opponent.board.misses = misses;
+
+    int turns = 1;
+    resolveMove(&bot, &opponent, 0, cell / GRID_SIZE, cell % GRID_SIZE);
+    updateGameState(&opponent, &bot);
+    for (; opponent.shipsSunk < SHIPS_COUNT && turns < MAX_HEADLESS_TURNS; turns++)
+    {
+        if (makeMove(&bot, &opponent))
+            updateGameState(&opponent, &bot);
+    }
+    return turns;
+}
+
+// common random numbers: rollout i of every candidate plays the same fleet with the same bot seed,
+// so the candidates differ by their shot and little else
+void openingWorkerMain(void *arg)
+{
+    OpeningWorker *worker = (OpeningWorker *)arg;
+    Rng rng;
+    for (long i = worker->id; i < worker->rollouts; i += worker->workerCount)
+    {
+        rngSeed(&rng, gameSeed(worker->seed, 0, i));
+        int human = (int)(i % 100) < worker->human; // the same share of human fleets on any thread count
+        Fleet fleet;
+        int drawn, attempts = 0;
+        do
+            drawn = sampleOpeningFleet(worker->evidence, &rng, &fleet);
+        while ((drawn == 0 || (human && drawn != 2)) && ++attempts < OPENING_ATTEMPTS);
+        if (drawn == 0 || (human && drawn != 2))
         {
-            char c;
-            switch (player->grid[i][j])
-            {
-            case miss:
-                if (mode == 0) // easy mode, show miss*/
-                    c = 'o';
-               else // hard mode, don't show miss*/
-                    c = '~';
-               break;
-            case hit:
-                c = '*';
-              break;
-            default: // undiscovered: cell empty or has a ship (ships not displayed on grid)*/
-               c = '~';
-                break;
-            }
-            printf(" %c", c);
+            worker->exhausted = 1; // whether some rollout gets here does not depend on the thread count
+            break;
+        }
+        Bitboard ships = fleetMask(&fleet);
+        uint64_t botSeed = rngNext(&rng);
+        for (int c = 0; c < worker->candidateCount; c++)
+        {
+            int cell = worker->candidates[c];
+            worker->shots[cell] += openingRollout(&worker->arena, &fleet, worker->misses, cell, botSeed);
+            worker->hits[cell] += bbTest(ships, cell / GRID_SIZE, cell % GRID_SIZE);
         }
-        printf("\n");
     }
+    INSTRUMENT_FLUSH();
 }
 
-void placeShips(Player *player)
+// shot by shot, the cell after which the Hard bot needs the fewest turns to win on average, found
+// by playing the rest of the game out. Every sum is a whole number, so the book does not depend on
+// the thread count
+int runBuildOpeningBook(int argc, char *argv[])
 {
-    if (!(player->isBot))
+    const char *path = argv[2];
+    int threads = cpuCount();
+    uint64_t seed = (uint64_t)time(NULL);
+    int depth = OPENING_DEPTH, human = OPENING_HUMAN;
+    long rollouts = OPENING_ROLLOUTS;
+    for (int i = 3; i < argc; i++)
     {
-        // instructions:
-        printf("These are your ships and their sizes: \ncarrier, 5 cells\nbattleship, 4 cells\ndestroyer, 3 cells\nsubmarine, 2 cells\n");
-        printf("\n");
-        printf("Please provide the coordinates and orientation to place each ship on the grid (e.g. B3, Horizontal).\n");
-        printf("The coordinates indicate the starting position of the ship. Horizontal orientation moves from left to right, and vertical orientation moves from top to bottom.\n");
-        printf("Follow this exact format: \ncoordinates: ColumnRow  (CapitalLetter[A->J]Number[1->10]) (e.g. B3)\norientation: 'H' for horizontal, 'V' for vertical\n");
-        printf("\n");
-        printf("Your input:\n");
+        if (strncmp(argv[i], "--seed=", 7) == 0)
+            seed = strtoull(argv[i] + 7, NULL, 10);
+        else if (strncmp(argv[i], "--depth=", 8) == 0)
+            depth = atoi(argv[i] + 8);
+        else if (strncmp(argv[i], "--rollouts=", 11) == 0)
+            rollouts = atol(argv[i] + 11);
+        else if (strncmp(argv[i], "--human=", 8) == 0)
+            human = atoi(argv[i] + 8);
+        else
+            threads = atoi(argv[i]);
+    }
+    if (threads <= 0 || depth <= 0 || depth > 255 || rollouts <= 0 || human < 0 || human > 100) // depth: one byte in the header
+    {
+        printUsage(argv[0]);
+        return 1;
     }
 
-    for (int shipSize = 5; shipSize > 1; shipSize--)
+    OpeningWorker *workers = (OpeningWorker *)malloc(sizeof(OpeningWorker) * threads);
+    countAllocation();
+    TablebaseEntry *entries = (TablebaseEntry *)malloc(sizeof(TablebaseEntry) * depth);
+    countAllocation();
+    if (workers == NULL || entries == NULL)
+    {
+        printf("Failed to allocate needed memory\n");
+        exit(1);
+    }
+    for (int w = 0; w < threads; w++)
+        workers[w].arena = createArena(GAME_ARENA_BYTES);
+
+    printf("seed: %llu\n", (unsigned long long)seed);
+    Bitboard misses = bbFromBits(0);
+    double start = wallSeconds();
+    int shot = 0;
+    for (; shot < depth; shot++)
     {
-        if (!(player->isBot))
+        MonteCarloEvidence evidence;
+        int room = 1;
+        for (int k = 0; k < SHIPS_COUNT; k++)
         {
-            placeShip(player, shipSize);
-            getchar();
+            evidence.count[k] = 0;
+            for (int p = 0; p < placements.count[k]; p++)
+            {
+                if (!bbAny(bbAnd(placements.mask[k][p], misses)))
+                    evidence.placement[k][evidence.count[k]++] = (unsigned char)p;
+            }
+            room = room && evidence.count[k] > 0;
         }
-        else
+        if (!room)
+            break;
+
+        // a cell and its images under the symmetries that leave the misses alone play the same
+        int same[SYMMETRIES], sameCount = 0;
+        for (int s = 1; s < SYMMETRIES; s++)
+        {
+            Bitboard image = bbTransform(misses, s);
+            if (image.lo == misses.lo && image.hi == misses.hi)
+                same[sameCount++] = s;
+        }
+        int candidates[GRID_SIZE * GRID_SIZE], candidateCount = 0;
+        for (int cell = 0; cell < GRID_SIZE * GRID_SIZE; cell++)
+        {
+            int lowest = !bbTest(misses, cell / GRID_SIZE, cell % GRID_SIZE);
+            for (int i = 0; i < sameCount && lowest; i++)
+                lowest = symmetryCell[same[i]][cell] >= cell;
+            if (lowest)
+                candidates[candidateCount++] = cell;
+        }
+
+        for (int w = 0; w < threads; w++)
+        {
+            Arena arena = workers[w].arena;
+            memset(&workers[w], 0, sizeof(OpeningWorker));
+            workers[w].id = w;
+            workers[w].workerCount = threads;
+            workers[w].misses = misses;
+            workers[w].evidence = &evidence;
+            workers[w].candidates = candidates;
+            workers[w].candidateCount = candidateCount;
+            workers[w].seed = gameSeed(seed, 0, shot);
+            workers[w].rollouts = rollouts;
+            workers[w].human = human;
+            workers[w].arena = arena;
+        }
+        runWorkers(threads, openingWorkerMain, workers, sizeof(OpeningWorker));
+        int exhausted = 0;
+        for (int w = 0; w < threads; w++)
+            exhausted = exhausted || workers[w].exhausted;
+        if (exhausted)
+            break;
+
+        int bestCell = -1;
+        long best = 0, hits = 0;
+        for (int c = 0; c < candidateCount; c++)
         {
-            botPlaceShip(player, shipSize);
+            int cell = candidates[c];
+            long shots = 0, cellHits = 0;
+            for (int w = 0; w < threads; w++)
+            {
+                shots += workers[w].shots[cell];
+                cellHits += workers[w].hits[cell];
+            }
+            if (bestCell < 0 || shots < best)
+            {
+                best = shots;
+                bestCell = cell;
+                hits = cellHits;
+            }
         }
+
+        int symmetry;
+        TablebaseEntry *entry = &entries[shot];
+        entry->key = canonicalOpeningKey(misses, &symmetry);
+        entry->expected = (uint32_t)(1000.0 * best / rollouts + 0.5);
+        entry->move = 0;
+        int row = bestCell / GRID_SIZE, col = bestCell % GRID_SIZE;
+        printf("shot %d: %c%d, %.1f%% hit, %.2f turns to win\n", shot + 1, 'A' + col, row + 1, 100.0 * hits / rollouts,
+               (double)best / rollouts);
+        transformMove(0, &row, &col, symmetry);
+        entry->row = (signed char)row;
+        entry->col = (signed char)col;
+        misses = bbOr(misses, bbCell(bestCell / GRID_SIZE, bestCell % GRID_SIZE)); // the book goes on after a miss only
+    }
+    double seconds = wallSeconds() - start;
+    if (shot < depth) // the misses so far leave too little room for the fleets, or none
+        printf("shot %d: fleets no longer fit around %d misses, the book stops at %d shots\n", shot + 1, shot, shot);
+
+    int written = writeTablebase(path, OPENING_MAGIC, shot, entries, shot);
+    if (!written)
+        printf("Cannot create %s\n", path);
+    else
+    {
+        printf("%s: %d shots, %ld rollouts per candidate, %d%% against human placements\n", path, shot, rollouts, human);
+        printf("%.3f s on %d threads\n", seconds, threads);
+    }
+    for (int w = 0; w < threads; w++)
+        freeArena(&workers[w].arena);
+    free(entries);
+    free(workers);
+    return !written;
+}
+
+/*-------------------------------------------------------------Bitboards--------------------------------------------------------------------*/
+
+#define COLUMN_LO 0x1004010040100401ULL // cells 0, 10, ..., 60: column A in the low word
+#define COLUMN_HI 0x0000000004010040ULL // cells 70, 80, 90: column A in the high word
+
+Bitboard bbFromBits(uint64_t bits)
+{
+    Bitboard b = {bits, 0};
+    return b;
+}
+
+Bitboard bbShiftLeft(Bitboard b, int n) // n in 0..127
+{
+    Bitboard r;
+    if (n == 0)
+        return b;
+    if (n < 64)
+    {
+        r.lo = b.lo << n;
+        r.hi = (b.hi << n) | (b.lo >> (64 - n));
+    }
+    else
+    {
+        r.lo = 0;
+        r.hi = b.lo << (n - 64);
+    }
+    return r;
+}
+
+Bitboard bbCell(int row, int col)
+{
+    return bbShiftLeft(bbFromBits(1), row * GRID_SIZE + col);
+}
+
+Bitboard bbRow(int row)
+{
+    return bbShiftLeft(bbFromBits((1ULL << GRID_SIZE) - 1), row * GRID_SIZE);
+}
+
+Bitboard bbColumn(int col)
+{
+    Bitboard column = {COLUMN_LO, COLUMN_HI};
+    return bbShiftLeft(column, col);
+}
+
+Bitboard bbSquare(int row, int col)
+{
+    return bbShiftLeft(bbFromBits(3ULL | (3ULL << GRID_SIZE)), row * GRID_SIZE + col);
+}
+
+Bitboard bbShip(int shipSize, int row, int col, int isVertical)
+{
+    uint64_t bits = 0;
+    for (int i = 0; i < shipSize; i++)
+        bits |= 1ULL << (isVertical ? i * GRID_SIZE : i);
+    return bbShiftLeft(bbFromBits(bits), row * GRID_SIZE + col);
+}
+
+Bitboard bbAnd(Bitboard a, Bitboard b)
+{
+    Bitboard r = {a.lo & b.lo, a.hi & b.hi};
+    return r;
+}
+
+Bitboard bbOr(Bitboard a, Bitboard b)
+{
+    Bitboard r = {a.lo | b.lo, a.hi | b.hi};
+    return r;
+}
+
+Bitboard bbAndNot(Bitboard a, Bitboard b)
+{
+    Bitboard r = {a.lo & ~b.lo, a.hi & ~b.hi};
+    return r;
+}
+
+Bitboard bbXor(Bitboard a, Bitboard b)
+{
+    Bitboard r = {a.lo ^ b.lo, a.hi ^ b.hi};
+    return r;
+}
+
+Bitboard bbShiftRight(Bitboard b, int n) // n in 0..127
+{
+    Bitboard r;
+    if (n == 0)
+        return b;
+    if (n < 64)
+    {
+        r.lo = (b.lo >> n) | (b.hi << (64 - n));
+        r.hi = b.hi >> n;
+    }
+    else
+    {
+        r.lo = b.hi >> (n - 64);
+        r.hi = 0;
     }
+    return r;
+}
+
+Bitboard bbFull()
+{
+    return bbLowCells(GRID_SIZE * GRID_SIZE);
+}
+
+Bitboard bbLowCells(int n) // n in 0..128
+{
+    Bitboard r;
+    r.lo = n >= 64 ? ~0ULL : (1ULL << n) - 1;
+    r.hi = n <= 64 ? 0 : (n >= 128 ? ~0ULL : (1ULL << (n - 64)) - 1);
+    return r;
+}
 
-    printf("Done placing %s's ships! Press enter to proceed\n", player->name);
+Bitboard bbLeftColumns(int n)
+{
+    Bitboard r = bbFromBits(0);
+    for (int col = 0; col < n; col++)
+        r = bbOr(r, bbColumn(col));
+    return r;
+}
 
-    getchar();
-    system("cls");
+Bitboard bbNeighbours(Bitboard b)
+{
+    Bitboard up = bbShiftRight(b, GRID_SIZE);
+    Bitboard down = bbAnd(bbShiftLeft(b, GRID_SIZE), bbFull());
+    Bitboard left = bbShiftRight(bbAndNot(b, bbColumn(0)), 1);
+    Bitboard right = bbShiftLeft(bbAndNot(b, bbColumn(GRID_SIZE - 1)), 1);
+    return bbAndNot(bbOr(bbOr(up, down), bbOr(left, right)), b);
 }
 
-void placeShip(Player *player, int shipSize)
+int bbTest(Bitboard b, int row, int col)
 {
-    char *name = getShipName(shipSize);
-    int rw;
-    char cl, orientation;
+    int i = row * GRID_SIZE + col;
+    return i < 64 ? (int)((b.lo >> i) & 1) : (int)((b.hi >> (i - 64)) & 1);
+}
 
-    // read position:
-    printf("\n(ship name: %s, ship size: %d)\n", name, shipSize);
-    printf("coordinates (e.g. B3): ");
-    scanf(" %c%d", &cl, &rw);
-    clearInputBuffer();
-    printf("orientation (H/V): ");
-    scanf(" %c", &orientation);
-    printf("\n");
+int bbAny(Bitboard b)
+{
+    return (b.lo | b.hi) != 0;
+}
 
-    // map input to coordinates on the grid with 0-based index:
-    int col = cl - 'A';
-    int row = rw - 1;
+int popcount64(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(x);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    return (int)__popcnt64(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
 
-    // validate coordinates, and place ship or try again:
-    if (canPlaceShip(player, shipSize, row, col, orientation)) // place this ship, then move on to the next
-    {
-        if (orientation == 'H')
-        {
-            for (int j = col; j < col + shipSize; j++)
-            {
-                player->grid[row][j] = shipSize;
-            }
-        }
-        else
-        {
-            for (int j = row; j < row + shipSize; j++)
-            {
-                player->grid[j][col] = shipSize;
-            }
-        }
-    }
-    else // try again with same ship
-    {
-        placeShip(player, shipSize);
-    }
+int lowestBit64(uint64_t x) // x != 0
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(x);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (int)index;
+#else
+    int i = 0;
+    while (!((x >> i) & 1))
+        i++;
+    return i;
+#endif
 }
 
-int canPlaceShip(Player *player, int shipSize, int row, int col, char orientation)
+int highestBit64(uint64_t x) // x != 0
 {
-    if (col < 0 || col > 9 || row < 0 || row > 9 || (orientation != 'H' && orientation != 'V'))
-    {
-        printf("Invalid input format! Please try again while following the specified input format directions:\n\n");
-        return 0;
-    }
-    else
-    {
-        if (orientation == 'H')
-        {
-            if (col + shipSize > 10)
-            {
-                printf("Error: chosen coordinates extend beyond the grid! Try again:\n");
-                return 0;
-            }
-            for (int j = col; j < col + shipSize; j++)
-            {
-                if (player->grid[row][j] != empty)
-                {
-                    printf("Error: chosen coordinates overlap with another ship! Try again:\n");
-                    return 0;
-                }
-            }
-        }
-        else if (orientation == 'V')
-        {
-            if (row + shipSize > 10)
-            {
-                printf("Error: chosen coordinates extend beyond the grid! Try again:\n");
-                return 0;
-            }
-            for (int j = row; j < row + shipSize; j++)
-            {
-                if (player->grid[j][col] != empty)
-                {
-                    printf("Error: chosen coordinates overlap with another ship! Try again:\n");
-                    return 0;
-                }
-            }
-        }
-    }
-    return 1;
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(x);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanReverse64(&index, x);
+    return (int)index;
+#else
+    int i = 63;
+    while (!((x >> i) & 1))
+        i--;
+    return i;
+#endif
 }
 
-void botPlaceShip(Player *player, int shipSize)
+int bbCount(Bitboard b)
 {
-    int row, col, isVertical;
+    return popcount64(b.lo) + popcount64(b.hi);
+}
 
-    do
+int bbPopFirst(Bitboard *b)
+{
+    if (b->lo)
     {
-        isVertical = rand() % 2;
-        if (isVertical)
-        {
-            row = randomCoordinate(GRID_SIZE - shipSize + 1);
-            col = randomCoordinate(GRID_SIZE);
-        }
-        else
-        {
-            row = randomCoordinate(GRID_SIZE);
-            col = randomCoordinate(GRID_SIZE - shipSize + 1);
-        }
-    } while (botShipOverlap(player, shipSize, row, col, isVertical));
+        int i = lowestBit64(b->lo);
+        b->lo &= b->lo - 1;
+        return i;
+    }
+    int i = lowestBit64(b->hi);
+    b->hi &= b->hi - 1;
+    return 64 + i;
+}
 
-    if (isVertical)
+int bbNth(Bitboard b, int n)
+{
+    uint64_t word = b.lo;
+    int base = 0;
+    if (n >= popcount64(b.lo))
     {
-        for (int j = row; j < row + shipSize; j++)
-        {
-            player->grid[j][col] = shipSize;
-            addCell(&(player->botsShipsCoord->head), j, col);
-        }
+        n -= popcount64(b.lo);
+        word = b.hi;
+        base = 64;
     }
-    else
+    for (int width = 32; width >= 8; width /= 2) // halve the word until the cell is in the lowest byte
     {
-        for (int j = col; j < col + shipSize; j++)
+        int low = popcount64(word & ((1ULL << width) - 1));
+        if (n >= low)
         {
-            player->grid[row][j] = shipSize;
-            addCell(&(player->botsShipsCoord->head), row, j);
+            n -= low;
+            word >>= width;
+            base += width;
         }
     }
+    while (n-- > 0)
+        word &= word - 1;
+    return base + lowestBit64(word);
 }
 
-int botShipOverlap(Player *player, int shipSize, int row, int col, int isVertical)
+/*-------------------------------------------------------------Packed State-----------------------------------------------------------------*/
+
+void packPlayer(PackedPlayer *packed, Player *player)
 {
-    if (isVertical)
+    Board *board = &player->board;
+    packed->ships = board->ships;
+    packed->hits = board->hits;
+    packed->misses = board->misses;
+    packed->smoke = board->smoke;
+    for (int k = 0; k < SHIPS_COUNT; k++)
     {
-        for (int j = row; j < row + shipSize; j++)
+        packed->placement[k] = PACKED_UNPLACED;
+        if (bbAny(board->shipMask[k])) // top-left cell, and the next one tells the orientation
         {
-            if (player->grid[j][col] != empty)
-            {
-                return 1;
-            }
-        }
-    }
-    else
-    {
-        for (int j = col; j < col + shipSize; j++)
-        {
-            if (player->grid[row][j] != empty)
-            {
-                return 1;
-            }
+            Bitboard cells = board->shipMask[k];
+            int first = bbPopFirst(&cells);
+            int isVertical = bbPopFirst(&cells) == first + GRID_SIZE;
+            packed->placement[k] = (unsigned char)placementIndex(k + 2, first / GRID_SIZE, first % GRID_SIZE, isVertical);
         }
+        packed->remainingHits[k] = (signed char)player->ships[k].remainingHits;
     }
-    return 0;
+    for (int m = 0; m < MOVES_COUNT; m++)
+        packed->countAvailable[m] = (signed char)player->moves[m].countAvailable;
+    packed->shipsSunk = (unsigned char)player->shipsSunk;
+    packed->lastMove = (signed char)player->lastMove;
+    packed->difficulty = (signed char)(player->isBot ? player->difficulty : -1);
 }
 
-char *getShipName(int i)
+// names, the ship and move tables and bot memory stay as they are
+void unpackPlayer(Player *player, PackedPlayer *packed)
 {
-    char *name;
-    switch (i)
+    Board *board = &player->board;
+    board->ships = packed->ships;
+    board->hits = packed->hits;
+    board->misses = packed->misses;
+    board->smoke = packed->smoke;
+    memset(board->shipAt, 0, sizeof(board->shipAt));
+    player->sinking = 0;
+    for (int k = 0; k < SHIPS_COUNT; k++)
     {
-    case 5:
-        name = "carrier";
-        break;
-    case 4:
-        name = "battleship";
-        break;
-    case 3:
-        name = "destroyer";
-        break;
-    case 2:
-        name = "submarine";
-        break;
+        board->shipMask[k] = packedShipMask(packed, k);
+        for (Bitboard cells = board->shipMask[k]; bbAny(cells);)
+            board->shipAt[bbPopFirst(&cells)] = (unsigned char)(k + 1);
+        player->ships[k].remainingHits = packed->remainingHits[k];
+        if (packed->remainingHits[k] == 0) // sunk by the last strike, not counted yet
+            player->sinking |= 1 << k;
     }
-    return name;
+    for (int m = 0; m < MOVES_COUNT; m++)
+        player->moves[m].countAvailable = packed->countAvailable[m];
+    player->shipsSunk = packed->shipsSunk;
+    player->lastMove = packed->lastMove;
 }
 
-void clearInputBuffer()
+void packGame(PackedGame *game, Player *players[2], Rng *rng, int current, int turns)
 {
-    int c;
-    while ((c = getchar()) != '\n' && c != EOF)
-        ;
+    memset(game, 0, sizeof(PackedGame)); // padding too, so packed games compare with memcmp
+    packPlayer(&game->players[0], players[0]);
+    packPlayer(&game->players[1], players[1]);
+    game->rng = *rng;
+    game->current = (unsigned char)current;
+    game->turns = (unsigned short)turns;
 }
-/*-----------------------------------------------------------Game Play-----------------------------------------------------------------*/
 
-void takeTurn(Player *player, Player *opponent)
+void unpackGame(Player *players[2], Rng *rng, PackedGame *game)
 {
-    if (player->isBot)
-    {
-        // Bot's turn logic
-        printf("%s taking turn...\n", player->name);
-    }
-    else
-    {
-        printf("%s's Turn! Press enter to proceed \n", player->name);
-        getchar();
-        system("cls");
+    unpackPlayer(players[0], &game->players[0]);
+    unpackPlayer(players[1], &game->players[1]);
+    *rng = game->rng;
+}
 
-        printf("%s's current grid: \n\n", opponent->name);
-        displayGrid(opponent);
+Bitboard packedShipMask(PackedPlayer *player, int k)
+{
+    if (player->placement[k] == PACKED_UNPLACED)
+        return bbFromBits(0);
+    return placements.mask[k][player->placement[k]];
+}
 
-        printf("\nAvailable moves: \n\n");
-        displayAvailableMoves(player, opponent);
-    }
-    if (makeMove(player, opponent))
-    { // move complete, player did not lose their turn
-        updateGameState(opponent, player);
-        printf("\n%s's updated grid: \n\n", opponent->name);
-        displayGrid(opponent);
-    }
-    else
-    {
+int packedStrike(PackedPlayer *opponent, Bitboard target)
+{
+    Bitboard newHits = bbAndNot(bbAnd(target, opponent->ships), opponent->hits);
+    opponent->hits = bbOr(opponent->hits, newHits);
+    opponent->misses = bbOr(opponent->misses, bbAndNot(target, opponent->ships));
+    for (int k = 0; k < SHIPS_COUNT; k++)
+        opponent->remainingHits[k] -= (signed char)bbCount(bbAnd(newHits, packedShipMask(opponent, k)));
+    return bbCount(newHits);
+}
 
-        getchar();
-    }
+int packedRadar(PackedPlayer *opponent, int row, int col)
+{
+    Bitboard found = bbAndNot(bbAndNot(bbAnd(bbSquare(row, col), opponent->ships), opponent->hits), opponent->smoke);
+    return bbAny(found);
+}
 
-    getchar();
-    printf("\nPress enter to proceed!\n");
-    getchar();
-    system("cls");
+void packedSmoke(PackedPlayer *player, int row, int col)
+{
+    Bitboard hidden = bbAndNot(bbAnd(bbSquare(row, col), player->ships), player->hits);
+    player->smoke = bbOr(player->smoke, hidden);
 }
 
-void displayAvailableMoves(Player *player, Player *opponent)
+void packedUpdateSinks(PackedPlayer *opponent, PackedPlayer *player)
 {
-    printf("FIRE, targets a cell of the opponent's grid.\n");
-    printf("Input format: identifier: '0', coordinate (e.g. B3)\n\n");
-    for (int i = 1; i < MOVES_COUNT; i++)
+    for (int k = 0; k < SHIPS_COUNT; k++)
     {
-        if (player->moves[i].countAvailable > 0)
+        if (opponent->remainingHits[k] != 0)
+            continue;
+        opponent->remainingHits[k] = -1;
+        opponent->shipsSunk++;
+        for (int m = 0; m < MOVES_COUNT; m++) // updateMoves()
         {
-            if (i == 1)
-            {
-                printf("RADAR SWEEP, reveals whether there are any opponent ships in a specified 2x2 area of their grid without showing exact locations of ships.\n");
-                printf("Input format: identifier: '1', top-left coordinate (e.g. B3, to target B3, B4, C3, C4)\n\n");
-            }
-            if (i == 2)
-            {
-                printf("SMOKE SCREEN, obscures a 2x2 area of your grid by hiding it from radar sweeps.\n");
-                printf("Input format: identifier: '2', top-left coordinate (e.g. B3, to target B3, B4, C3, C4)\n\n");
-            }
-            if (i == 3)
-            {
-                printf("ARTILLERY, an attack move that works similarly to FIRE but targets a 2x2 area.\n");
-                printf("Input format: identifier: '3', top-left coordinate (e.g. B3, to target B3, B4, C3, C4)\n\n");
-            }
-            if (i == 4)
-            {
-                printf("TORPEDO, powerful attack that targets an entire row or column.\n");
-                printf("Input format: identifier: '4', either row number (1->10) or column letter (A->J).\n\n");
-            }
+            if (moveUnlockThresholds[m] <= opponent->shipsSunk && player->countAvailable[m] >= 0)
+                player->countAvailable[m]++;
         }
     }
-    printf("\n");
 }
 
-int makeMove(Player *player, Player *opponent) // handle inputs that are not numbers
+/*---------------------------------------------------------Headless Simulation---------------------------------------------------------------*/
+
+GameResult playHeadlessGame(int difficulty1, int difficulty2, uint64_t seed, Arena *arena, ReplayWriter *replay)
 {
-    // Bot logic
-    if (player->isBot)
+    GameResult result;
+    memset(&result, 0, sizeof(result));
+    result.winner = -1;
+    result.seed = seed;
+
+    Rng rng;
+    rngSeed(&rng, seed);
+
+    Player bots[2];
+    arenaReset(arena); // the previous game's bots are done with it
+    bots[0] = createBotPlayer(difficulty1, arena);
+    bots[1] = createBotPlayer(difficulty2, arena);
+    bots[0].silent = 1;
+    bots[1].silent = 1;
+    bots[0].rng = &rng;
+    bots[1].rng = &rng;
+
+    placeShips(&bots[0]);
+    placeShips(&bots[1]);
+
+    // randomly choose starting bot, then alternate:
+    int current = rngBounded(&rng, 2);
+    if (replay != NULL)
     {
-        int moveChosen = -1; // Move chosen by the bot
-        int result = 0;
+        Player *players[2] = {&bots[0], &bots[1]};
+        replayBeginGame(replay, players, seed, current);
+    }
+    while (result.turns < MAX_HEADLESS_TURNS)
+    {
+        Player *player = &bots[current];
+        Player *opponent = &bots[1 - current];
+        result.turns++;
 
-        if (botCheckAvailable(player, 4)) // choose torpedo whenever it's available
-        {
-            moveChosen = 4;
-        }
-        else if (botCheckAvailable(player, 3)) // else, choose artillery whenever available
-        {
-            moveChosen = 3;
-        }
-        else if (botCheckAvailable(player, 2)) // else, choose smoke smoke screen whenever available
+        // same turn flow as takeTurn(), minus the console
+        if (makeMove(player, opponent))
         {
-            moveChosen = 2;
+            result.movesUsed[current][player->lastMove]++;
+            updateGameState(opponent, player);
         }
 
-        else
+        if (opponent->shipsSunk == SHIPS_COUNT)
         {
-            do
-            {
-                int r = rand() % 101;
-                if (r >= 80)
-                {
-                    moveChosen = 1; // choose radar sweep
-                }
-                else
-                {
-                    moveChosen = 0; // choose fire
-                }
-            } while (!botCheckAvailable(player, moveChosen)); // ensure the move is valid, i.e. we did not exhaust all 3 radar sweeps available
+            emitEvent(player, opponent, eventGameOver, -1, -1, -1, -1, 0);
+            result.winner = current;
+            break;
         }
-        
-        int decision = decideTarget(player); // 1 if target meaningfully, 0 if target randomly
+        current = 1 - current;
+    }
+    if (replay != NULL)
+        replayEndGame(replay, result.winner);
 
-        // Execute the chosen move for Easy Bot
-        switch (moveChosen)
-        {
-        case 0:                                        // FIRE logic for Easy Bot
-            printf("Bot performing Fire.\n");          // Print bot's move
-            result = fire(player, opponent, decision); // Perform the FIRE move
-            break;
+    freeAll(&bots[0]);
+    freeAll(&bots[1]);
+    return result;
+}
 
-        case 1: // RADAR SWEEP (Placeholder for Easy Bot Logic)
-            printf("Bot performs Radar Sweep.\n");
-            result = radarSweep(player, opponent);
-            break;
+int runCommandLine(int argc, char *argv[])
+{
+    if (strcmp(argv[1], "--simulate") == 0 && argc >= 5 && argc <= 6)
+    {
+        return runSimulation(argc, argv);
+    }
+    if (strcmp(argv[1], "--tournament") == 0 && argc >= 3 && argc <= 7)
+    {
+        return runTournament(argc, argv);
+    }
+    if (strcmp(argv[1], "--sample-fleets") == 0 && argc >= 3 && argc <= 4)
+    {
+        return runFleetBenchmark(argc, argv);
+    }
+    if (strcmp(argv[1], "--benchmark") == 0 && argc <= 5)
+    {
+        return runBenchmark(argc, argv);
+    }
+    if (strcmp(argv[1], "--replay-stats") == 0 && argc >= 3)
+    {
+        return runReplayStats(argc, argv);
+    }
+    if (strcmp(argv[1], "--replay") == 0 && argc >= 4 && argc <= 5)
+    {
+        return runReplay(argc, argv);
+    }
+    if (strcmp(argv[1], "--replay-check") == 0 && argc >= 3)
+    {
+        return runReplayCheck(argc, argv);
+    }
+    if (strcmp(argv[1], "--self-test") == 0 && argc <= 4)
+    {
+        return runSelfTest(argc, argv);
+    }
+    if (strcmp(argv[1], "--build-tablebase") == 0 && argc >= 4)
+    {
+        return runBuildTablebase(argc, argv);
+    }
+    if (strcmp(argv[1], "--build-opening-book") == 0 && argc >= 3)
+    {
+        return runBuildOpeningBook(argc, argv);
+    }
+    printUsage(argv[0]);
+    return 1;
+}
 
-        case 2: // SMOKE SCREEN (Placeholder for Easy Bot Logic)
-            printf("Bot uses Smoke Screen.\n");
-            result = smokeScreen(player, opponent);
-            break;
+void printUsage(char *program)
+{
+    printf("Usage: %s                                              interactive game\n", program);
+    printf("       %s --simulate <games> <difficulty1> <difficulty2> [seed]  one bot pairing on one thread\n", program);
+    printf("       %s --tournament <games per pairing> [threads] [--scaling] [--seed=<seed>]\n", program);
+    printf("       %s --sample-fleets <count> [seed]  uniform random fleets, reports fleets/sec\n", program);
+    printf("       %s --benchmark [iterations] [games per pairing] [seed]  move kernels and games, JSON lines\n", program);
+    printf("Bot difficulty: 0: Easy, 1: Medium, 2: Hard, 3: Expert (placement density), 4: Master (Monte Carlo)\n");
+    printf("Master budget per move: --mc-samples=<fleets> --mc-ms=<milliseconds> --mc-threads=<threads>, anywhere\n");
+    printf("(default: %dms on every core in interactive games, %ld fleets on one thread headless)\n",
+           interactiveMonteCarlo.milliseconds, headlessMonteCarlo.samples);
+    printf("Master endgame solver: --endgame=<configurations> (0: off) --endgame-nodes=<states> --endgame-ms=<milliseconds>, anywhere\n");
+    printf("(default: at most %d placements of the ships afloat, %dms interactive, %ld states headless)\n",
+           headlessEndgame.configurations, interactiveEndgame.milliseconds, headlessEndgame.nodes);
+    printf("--latency, anywhere: bot move latency percentiles per difficulty and move at the end\n");
+    printf("--record=<file>, anywhere: --simulate writes its games to a binary replay log, --tournament to <file>.<thread>\n");
+    printf("       %s --replay-stats <file>...  scans replay logs: games, turns, bytes/turn, moves\n", program);
+    printf("       %s --replay <file> <game> [turn]  both boards of a recorded game after that many turns\n", program);
+    printf("       %s --replay-check <file>...  re-simulates every recorded game against its outcomes\n", program);
+    printf("       %s --self-test [games] [seed]  checks doMove/undoMove and the endgame solver on positions from bot games\n", program);
+    printf("       %s --build-tablebase <file> <games> [threads] [--seed=<seed>] [--configurations=<n>] [--nodes=<states>]\n", program);
+    printf("           solves the endgames of Master games offline (default: up to %d configurations, %d states each)\n",
+           TABLEBASE_CONFIGURATIONS, TABLEBASE_NODES);
+    printf("--tablebase=<file>, anywhere: Master bots look endgames up in it before solving them\n");
+    printf("       %s --build-opening-book <file> [threads] [--seed=<seed>] [--depth=<shots>] [--rollouts=<games>] [--human=<percent>]\n", program);
+    printf("           the Hard bot's best first shots against bot and human placements (default: %d shots, %d games each, %d%% human)\n",
+           OPENING_DEPTH, OPENING_ROLLOUTS, OPENING_HUMAN);
+    printf("--opening-book=<file>, anywhere: Hard bots take their first shots from it\n");
+}
 
-        case 3: // ARTILLERY (Placeholder for Easy Bot Logic)
-            printf("Bot fires Artillery.\n");
-            result = artillery(player, opponent, decision);
-            break;
+int runSimulation(int argc, char *argv[])
+{
+    long games = atol(argv[2]);
+    int difficulty1 = atoi(argv[3]);
+    int difficulty2 = atoi(argv[4]);
+    uint64_t seed = argc > 5 ? strtoull(argv[5], NULL, 10) : (uint64_t)time(NULL);
+    if (games <= 0 || difficulty1 < 0 || difficulty1 >= BOT_DIFFICULTIES || difficulty2 < 0 || difficulty2 >= BOT_DIFFICULTIES)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
 
-        case 4: // TORPEDO (Placeholder for Easy Bot Logic)
-            printf("Bot fires Torpedo.\n");
-            result = torpedo(player, opponent, decision);
-            break;
+    long wins[2] = {0, 0};
+    long unfinished = 0;
+    long turns = 0;
+    long movesUsed[MOVES_COUNT] = {0};
 
-        default:
-            printf("Bot failed to make a valid move.\n");
-            return 0; // Skip turn if no valid move is made
-        }
+    ReplayWriter *replay = NULL;
+    if (recordPath != NULL && (replay = openReplayWriter(recordPath)) == NULL)
+    {
+        printf("Cannot create %s\n", recordPath);
+        return 1;
+    }
 
-        if (result)
+    Arena arena = createArena(GAME_ARENA_BYTES);
+    long allocations = atomic_load(&heapAllocations);
+    double start = wallSeconds();
+    for (long g = 0; g < games; g++)
+    {
+        GameResult result = playHeadlessGame(difficulty1, difficulty2, gameSeed(seed, 0, g), &arena, replay);
+        if (result.winner < 0)
+            unfinished++;
+        else
+            wins[result.winner]++;
+        turns += result.turns;
+        for (int i = 0; i < MOVES_COUNT; i++)
+            movesUsed[i] += result.movesUsed[0][i] + result.movesUsed[1][i];
+    }
+    double seconds = wallSeconds() - start;
+    allocations = atomic_load(&heapAllocations) - allocations;
+    freeArena(&arena);
+
+    printf("seed: %llu\n", (unsigned long long)seed);
+    printf("games: %ld, bot1 wins: %ld, bot2 wins: %ld, unfinished: %ld\n", games, wins[0], wins[1], unfinished);
+    printf("average turns per game: %.2f\n", games > 0 ? (double)turns / games : 0.0);
+    printf("moves used: fire %ld, radar %ld, smoke %ld, artillery %ld, torpedo %ld\n",
+           movesUsed[0], movesUsed[1], movesUsed[2], movesUsed[3], movesUsed[4]);
+    printf("time: %.3f s, %.0f games/sec\n", seconds, seconds > 0 ? games / seconds : 0.0);
+    printf("heap allocations during the games: %ld\n", allocations);
+    if (replay != NULL)
+    {
+        uint64_t bytes = replay->bytes + replay->used;
+        long recorded = replay->turns;
+        if (!closeReplayWriter(replay))
         {
-            player->moves[moveChosen].countAvailable--; // Decrement move availability
+            printf("Cannot write %s\n", recordPath);
+            return 1;
         }
-
-        return result; // Return whether the bot successfully made a move
+        printf("recorded to %s: %llu bytes, %.2f bytes/turn\n", recordPath, (unsigned long long)bytes,
+               recorded > 0 ? (double)bytes / recorded : 0.0);
     }
+    return 0;
+}
 
-    // Human player logic
-    char input[10];
-    int move;
-    int result = 0;
+/*-------------------------------------------------------------Replay Log-------------------------------------------------------------------*/
 
-    while (1)
+ReplayWriter *openReplayWriter(const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+        return NULL;
+    ReplayWriter *writer = (ReplayWriter *)malloc(sizeof(ReplayWriter));
+    countAllocation();
+    if (writer == NULL)
     {
-        printf("Enter the identifier for your chosen move: ");
-        scanf("%s", input); // Read input as a string
-
-        // Check if the input is a valid number
-        int validInput = 1; // Flag to check if input is valid
-        for (size_t i = 0; i < strlen(input); i++)
-        {
-            if (!isdigit(input[i]))
-            {
-                validInput = 0; // Not a valid number
-                break;
-            }
-        }
+        printf("Failed to allocate needed memory\n");
+        exit(1);
+    }
+    memset(writer, 0, sizeof(ReplayWriter));
+    writer->file = file;
+    writer->sink.handler = replayEvents;
+    writer->sink.context = writer;
+
+    unsigned char version[4] = {REPLAY_VERSION, 0, 0, 0};
+    replayPut(writer, REPLAY_MAGIC, 8);
+    replayPut(writer, version, 4);
+    return writer;
+}
 
-        if (validInput)
-        {
-            move = atoi(input); // Convert string to integer
+int closeReplayWriter(ReplayWriter *writer)
+{
+    int written = !writer->failed && fwrite(writer->buffer, 1, writer->used, writer->file) == writer->used;
+    if (fclose(writer->file) != 0)
+        written = 0;
+    free(writer);
+    return written;
+}
 
-            // Check if the move is within the valid range
-            if (move >= 0 && move < MOVES_COUNT)
-            {
-                checkOneRoundMoves(player, move);
+// tag, seed (8 bytes, little-endian), both difficulties, tracking mode, first player, then the
+// placement index of every ship of both players: 21 bytes
+void replayBeginGame(ReplayWriter *writer, Player *players[2], uint64_t seed, int first)
+{
+    unsigned char header[13 + 2 * SHIPS_COUNT];
+    header[0] = REPLAY_GAME_TAG;
+    for (int i = 0; i < 8; i++)
+        header[1 + i] = (unsigned char)(seed >> (8 * i));
+    for (int p = 0; p < 2; p++)
+    {
+        PackedPlayer packed; // finds the placement indices
+        packPlayer(&packed, players[p]);
+        header[9 + p] = (unsigned char)(packed.difficulty < 0 ? REPLAY_NONE : packed.difficulty);
+        memcpy(&header[13 + p * SHIPS_COUNT], packed.placement, SHIPS_COUNT);
+        writer->players[p] = players[p];
+        players[p]->events = &writer->sink;
+    }
+    header[11] = (unsigned char)mode;
+    header[12] = (unsigned char)first;
+    replayPut(writer, header, sizeof(header));
+    writer->games++;
+}
 
-                if (!checkAvailable(player, move))
-                {
-                    return 0; // Invalid move available
-                }
+void replayEndGame(ReplayWriter *writer, int winner)
+{
+    unsigned char end[2] = {0, (unsigned char)(winner < 0 ? REPLAY_NONE : winner)};
+    replayPut(writer, end, 2);
+    writer->players[0]->events = writer->players[1]->events = NULL;
+}
 
-                switch (move)
-                {
-                case 0:
-                    result = fire(player, opponent, 0);
-                    break;
-                case 1:
-                    result = radarSweep(player, opponent);
-                    break;
-                case 2:
-                    result = smokeScreen(player, opponent);
-                    break;
-                case 3:
-                    result = artillery(player, opponent, 0);
-                    break;
-                case 4:
-                    result = torpedo(player, opponent, 0);
-                    break;
-                default:
-                    break;
-                }
+// every move ends in exactly one of these events, which has the target and the outcome
+void replayEvents(GameEvent *event, void *context)
+{
+    ReplayWriter *writer = (ReplayWriter *)context;
+    if (event->type != eventHit && event->type != eventMiss && event->type != eventRadar && event->type != eventSmoke)
+        return;
+    int target = event->row * GRID_SIZE + event->col;
+    if (event->move == 4) // torpedo: the row, or GRID_SIZE + the column
+        target = event->col < 0 ? event->row : GRID_SIZE + event->col;
+    int side = event->player == writer->players[1];
+    replayPutVarint(writer, (uint64_t)REPLAY_TURN(side, event->move, target, event->count) + 1);
+    writer->turns++;
+}
 
-                if (result)
-                {
-                    player->moves[move].countAvailable--;
-                }
+void replayPut(ReplayWriter *writer, const void *bytes, size_t count)
+{
+    if (writer->used + count > REPLAY_BUFFER)
+    {
+        if (fwrite(writer->buffer, 1, writer->used, writer->file) != writer->used)
+            writer->failed = 1;
+        writer->bytes += writer->used;
+        writer->used = 0;
+    }
+    memcpy(writer->buffer + writer->used, bytes, count);
+    writer->used += count;
+}
 
-                break; // Exit the loop after a valid move
-            }
-        }
+void replayPutVarint(ReplayWriter *writer, uint64_t value) // 7 bits per byte, low first, high bit: more follow
+{
+    unsigned char bytes[10];
+    int n = 0;
+    while (value >= 0x80)
+    {
+        bytes[n++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    bytes[n++] = (unsigned char)value;
+    replayPut(writer, bytes, n);
+}
 
-        // If input is not a valid number or not in range
-        printf("\nInvalid input! Please choose again from the list of available moves using the specified format:\n\n");
+// access: MADV_SEQUENTIAL or MADV_RANDOM, a hint for the read-ahead (ignored on Windows)
+int mapFile(MappedFile *map, const char *path, int access)
+{
+    memset(map, 0, sizeof(MappedFile));
+#ifdef _WIN32
+    map->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (map->file == INVALID_HANDLE_VALUE)
+        return 0;
+    LARGE_INTEGER size;
+    GetFileSizeEx(map->file, &size);
+    map->size = (size_t)size.QuadPart;
+    map->mapping = map->size > 0 ? CreateFileMappingA(map->file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    if (map->mapping != NULL)
+        map->data = (const unsigned char *)MapViewOfFile(map->mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    int file = open(path, O_RDONLY);
+    if (file < 0)
+        return 0;
+    struct stat status;
+    if (fstat(file, &status) == 0 && status.st_size > 0)
+    {
+        map->size = (size_t)status.st_size;
+        void *data = mmap(NULL, map->size, PROT_READ, MAP_PRIVATE, file, 0);
+        map->data = data == MAP_FAILED ? NULL : (const unsigned char *)data;
+        if (map->data != NULL)
+            madvise(data, map->size, access);
+    }
+    close(file); // the mapping stays valid
+#endif
+    if (map->data == NULL)
+    {
+        unmapFile(map);
+        return 0;
     }
+    return 1;
+}
 
-    return 1; // Return success
+void unmapFile(MappedFile *map)
+{
+#ifdef _WIN32
+    if (map->data != NULL)
+        UnmapViewOfFile(map->data);
+    if (map->mapping != NULL)
+        CloseHandle(map->mapping);
+    if (map->file != NULL && map->file != INVALID_HANDLE_VALUE)
+        CloseHandle(map->file);
+#else
+    if (map->data != NULL)
+        munmap((void *)map->data, map->size);
+#endif
+    memset(map, 0, sizeof(MappedFile));
 }
 
-int decideTarget(Player *bot) // returns 1 if target meaninfully, 0 if target randomly
+int openReplay(ReplayReader *reader, const char *path)
 {
-    int percentage = 0;
-    int randVal;
-    if (bot->difficulty == 0) // bot difficulty: easy
+    reader->offset = 0;
+    if (!mapFile(&reader->map, path, MADV_SEQUENTIAL)) // games are scanned front to back
+        return 0;
+    if (reader->map.size < REPLAY_FILE_HEADER || memcmp(reader->map.data, REPLAY_MAGIC, 8) != 0 ||
+        reader->map.data[8] != REPLAY_VERSION)
     {
-        percentage = 50;
+        closeReplay(reader);
+        return 0;
     }
-    else if (bot->difficulty == 1) // medium
+    reader->offset = REPLAY_FILE_HEADER;
+    return 1;
+}
+
+void closeReplay(ReplayReader *reader)
+{
+    unmapFile(&reader->map);
+    reader->offset = 0;
+}
+
+int replayNextGame(ReplayReader *reader, ReplayGame *game)
+{
+    const int headerSize = 13 + 2 * SHIPS_COUNT;
+    if (reader->map.size - reader->offset < (size_t)headerSize || reader->map.data[reader->offset] != REPLAY_GAME_TAG)
+        return 0;
+    const unsigned char *header = reader->map.data + reader->offset;
+    memset(game, 0, sizeof(ReplayGame));
+    for (int i = 0; i < 8; i++)
+        game->seed |= (uint64_t)header[1 + i] << (8 * i);
+    for (int p = 0; p < 2; p++)
     {
-        percentage = 75;
+        game->difficulty[p] = header[9 + p] == REPLAY_NONE ? -1 : header[9 + p];
+        for (int k = 0; k < SHIPS_COUNT; k++)
+        {
+            game->placement[p][k] = header[13 + p * SHIPS_COUNT + k];
+            if (game->placement[p][k] >= placements.count[k])
+                return 0;
+            game->fleet[p] = bbOr(game->fleet[p], placements.mask[k][game->placement[p][k]]);
+        }
     }
-    else // hard
+    game->mode = header[11];
+    game->first = header[12];
+    game->winner = -1;
+    reader->offset += headerSize;
+    return 1;
+}
+
+int replayNextTurn(ReplayReader *reader, ReplayGame *game, ReplayTurn *turn)
+{
+    uint64_t value;
+    if (!replayGetVarint(reader, &value))
+        return 0;
+    if (value == 0) // end of the game, the winner follows
     {
-        percentage = 100;
+        if (reader->offset < reader->map.size)
+        {
+            int winner = reader->map.data[reader->offset++];
+            game->winner = winner == REPLAY_NONE ? -1 : winner;
+        }
+        return 0;
     }
-    randVal = rand() % 101;
-    if (randVal <= percentage)
+    value--;
+    turn->player = (int)(value & 1);
+    turn->move = (int)((value >> 1) & 7);
+    int target = (int)((value >> 4) & 127);
+    turn->outcome = (int)(value >> 11);
+    turn->row = target / GRID_SIZE;
+    turn->col = target % GRID_SIZE;
+    if (turn->move == 4)
     {
-        return 1;
+        turn->row = target < GRID_SIZE ? target : -1;
+        turn->col = target < GRID_SIZE ? -1 : target - GRID_SIZE;
     }
-    return 0;
+    game->turns++;
+    return 1;
 }
 
-void setCoordsMeaningfully(Player *player, Player *opponent, int *row, int *col)
+int replayGetVarint(ReplayReader *reader, uint64_t *value)
 {
-        Cell *current = player->botHitList->head;
-        Cell *radarCell = player->radaredList->head;
+    *value = 0;
+    for (int shift = 0; reader->offset < reader->map.size && shift < 64; shift += 7)
+    {
+        unsigned char byte = reader->map.data[reader->offset++];
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return 1;
+    }
+    return 0; // cut off mid-number
+}
 
-        if (radarCell != NULL) {
-            *row = radarCell->row;
-            *col = radarCell->col;
-            player->radaredList->head = radarCell->next;
-            return;
-        }
+// battleship --replay-stats <file>...
+int runReplayStats(int argc, char *argv[])
+{
+    long games = 0, turns = 0, unfinished = 0;
+    long wins[2] = {0, 0};
+    long movesUsed[MOVES_COUNT] = {0};
+    uint64_t bytes = 0;
 
-        if (current == NULL)
+    double start = wallSeconds();
+    for (int f = 2; f < argc; f++)
+    {
+        ReplayReader reader;
+        if (!openReplay(&reader, argv[f]))
         {
-            searchForHits(player, opponent, row, col);
+            printf("%s is not a replay log\n", argv[f]);
+            return 1;
         }
-        else
+        ReplayGame game;
+        ReplayTurn turn;
+        while (replayNextGame(&reader, &game))
         {
+            while (replayNextTurn(&reader, &game, &turn))
+                movesUsed[turn.move]++;
+            games++;
+            turns += game.turns;
+            if (game.winner < 0)
+                unfinished++;
+            else
+                wins[game.winner]++;
+        }
+        if (reader.offset != reader.map.size)
+            printf("%s: damaged after %llu bytes\n", argv[f], (unsigned long long)reader.offset);
+        bytes += reader.map.size;
+        closeReplay(&reader);
+    }
+    double seconds = wallSeconds() - start;
 
-            int direction = 0;
-
-            int baseRow = current->row;
-            int baseCol = current->col;
+    printf("games: %ld, bot1 wins: %ld, bot2 wins: %ld, unfinished: %ld\n", games, wins[0], wins[1], unfinished);
+    printf("turns: %ld, %.2f bytes/turn (headers included)\n", turns, turns > 0 ? (double)bytes / turns : 0.0);
+    printf("moves used: fire %ld, radar %ld, smoke %ld, artillery %ld, torpedo %ld\n",
+           movesUsed[0], movesUsed[1], movesUsed[2], movesUsed[3], movesUsed[4]);
+    printf("scan: %.3f s, %.0f turns/sec\n", seconds, seconds > 0 ? turns / seconds : 0.0);
+    return 0;
+}
 
-            for (int i = 0; i < 4; i++)
-            {
-                int targetRow = baseRow, targetCol = baseCol;
+ReplayEngine *createReplayEngine()
+{
+    ReplayEngine *engine = (ReplayEngine *)malloc(sizeof(ReplayEngine));
+    countAllocation();
+    if (engine == NULL)
+    {
+        printf("Failed to allocate needed memory\n");
+        exit(1);
+    }
+    memset(engine, 0, sizeof(ReplayEngine));
+    engine->players[0] = createPlayer(NULL);
+    engine->players[1] = createPlayer(NULL);
+    return engine;
+}
 
-                // hit's neighbors
-                switch(direction)
-                {
-                case 0:
-                    targetRow++;
-                    break; // Down
-                case 1:
-                    targetRow--;
-                    break; // Up
-                case 2:
-                    targetCol--;
-                    break; // Left
-                case 3:
-                    targetCol++;
-                    break; // Right
-                }
+void freeReplayEngine(ReplayEngine *engine)
+{
+    freeAll(&engine->players[0]);
+    freeAll(&engine->players[1]);
+    free(engine);
+}
 
-                // // Checking  bounds and whether the cell is undiscovered
-                if (targetRow >= 0 && targetRow < GRID_SIZE &&
-                    targetCol >= 0 && targetCol < GRID_SIZE &&
-                    opponent->grid[targetRow][targetCol] != hit &&
-                    opponent->grid[targetRow][targetCol] != miss)
-                {
-                    *row = targetRow;
-                    *col = targetCol;
-                    current = current->next;
-                    return;
-                }
+// reads the whole game, re-simulates it once to check every outcome and lay down the checkpoints,
+// and leaves the players at the end of it
+int replayLoad(ReplayEngine *engine, ReplayReader *reader)
+{
+    if (!replayNextGame(reader, &engine->game))
+        return 0;
+    engine->turnCount = 0;
+    int overLong = 0; // more turns than any game can last: the record is corrupt
+    ReplayTurn turn;
+    while (replayNextTurn(reader, &engine->game, &turn))
+    {
+        if (engine->turnCount < MAX_HEADLESS_TURNS)
+            engine->turns[engine->turnCount++] = turn;
+        else
+            overLong = 1;
+    }
 
-                // Rotate direction clockwise: if the current direction does not lead to a valid cell-->rotates to the next direction
-                direction = (direction + 1) % 4;
-            }
+    PackedGame *start = &engine->checkpoints[0];
+    memset(start, 0, sizeof(PackedGame));
+    for (int p = 0; p < 2; p++)
+    {
+        Fleet fleet;
+        memcpy(fleet.placement, engine->game.placement[p], SHIPS_COUNT);
+        packFleet(&start->players[p], &fleet);
+    }
+    start->current = (unsigned char)engine->game.first;
+    Player *players[2] = {&engine->players[0], &engine->players[1]};
+    unpackGame(players, &engine->rng, start);
+    engine->turn = 0;
+    engine->mismatches = 0;
+    engine->firstMismatch = -1;
+
+    for (int t = 0; t <= engine->turnCount; t++) // the end of the game can fall on a checkpoint too
+    {
+        if (t % REPLAY_CHECKPOINT_INTERVAL == 0)
+            packGame(&engine->checkpoints[t / REPLAY_CHECKPOINT_INTERVAL], players, &engine->rng, 0, t);
+        if (t < engine->turnCount && !replayApply(engine, &engine->turns[t]) && engine->mismatches++ == 0)
+            engine->firstMismatch = t;
+    }
 
-            searchForHits(player, opponent, row, col);
-            current = current->next;
-        }
+    int winner = -1;
+    for (int p = 0; p < 2; p++)
+    {
+        if (engine->players[1 - p].shipsSunk == SHIPS_COUNT)
+            winner = p;
+    }
+    if (winner != engine->game.winner && engine->mismatches++ == 0)
+        engine->firstMismatch = engine->turnCount;
+    if (overLong && engine->mismatches++ == 0) // the turns past the limit were never checked
+        engine->firstMismatch = engine->turnCount;
+    return 1;
 }
 
-//when the hitList is empty, it chooses coordinates with higher chance of having a ship
-void searchForHits(Player *player, Player *opponent, int* row, int* col) {
-    int coordsToCheck[9][2] = {
-            {0, 0}, {0, 4}, {0, 9},
-            {4, 0}, {4, 4}, {4, 9},
-            {9, 0}, {9, 4}, {9, 9}
-        };
-
-    for (int i = 0; i < 9; i++) {
-        int targetCol = coordsToCheck[i][0];
-        int targetRow = coordsToCheck[i][1];
+// the move through the same rules the game used, minus bots and console
+int replayApply(ReplayEngine *engine, ReplayTurn *turn)
+{
+    Player *player = &engine->players[turn->player];
+    Player *opponent = &engine->players[1 - turn->player];
+    int available = player->moves[turn->move].countAvailable != 0;
+
+    int outcome = resolveMove(player, opponent, turn->move, turn->row, turn->col);
+    if (player->moves[turn->move].countAvailable > 0)
+        player->moves[turn->move].countAvailable--;
+    player->lastMove = turn->move;
+    updateGameState(opponent, player);
+    engine->turn++;
+    return available && outcome == turn->outcome;
+}
 
-        if (targetRow >= 0 && targetRow < GRID_SIZE &&
-            targetCol >= 0 && targetCol < GRID_SIZE &&
-            opponent->grid[targetRow][targetCol] != hit &&
-            opponent->grid[targetRow][targetCol] != miss) {
+void replaySeek(ReplayEngine *engine, int turn)
+{
+    if (turn > engine->turnCount)
+        turn = engine->turnCount;
+    int checkpoint = turn / REPLAY_CHECKPOINT_INTERVAL;
+    if (turn < engine->turn || checkpoint > engine->turn / REPLAY_CHECKPOINT_INTERVAL) // the checkpoint is closer
+    {
+        Player *players[2] = {&engine->players[0], &engine->players[1]};
+        unpackGame(players, &engine->rng, &engine->checkpoints[checkpoint]);
+        engine->turn = checkpoint * REPLAY_CHECKPOINT_INTERVAL;
+    }
+    while (engine->turn < turn)
+        replayApply(engine, &engine->turns[engine->turn]);
+}
 
-            *row = targetRow;
-            *col = targetCol;
-            return;
+// the owner's view: ship sizes afloat, hits '*', misses 'o'
+void printReplayBoard(Player *player)
+{
+    printf("   A B C D E F G H I J\n");
+    for (int i = 0; i < GRID_SIZE; i++)
+    {
+        printf("%2d", i + 1);
+        for (int j = 0; j < GRID_SIZE; j++)
+        {
+            int state = cellState(&player->board, i, j);
+            printf(" %c", state == hit ? '*' : state == miss ? 'o' : state == empty ? '~' : '0' + state);
         }
+        printf("\n");
     }
+}
 
-    //if all were visited, choose random coordinates
-    do {
-        *row = randomCoordinate(GRID_SIZE);
-        *col = randomCoordinate(GRID_SIZE);
-    } while (opponent->grid[*row][*col] == hit || opponent->grid[*row][*col] == miss);
+// battleship --replay <file> <game> [turn]
+int runReplay(int argc, char *argv[])
+{
+    long wanted = atol(argv[3]);
+    ReplayReader reader;
+    if (!openReplay(&reader, argv[2]))
+    {
+        printf("%s is not a replay log\n", argv[2]);
+        return 1;
+    }
+    ReplayEngine *engine = createReplayEngine();
+    long g = 0;
+    int found;
+    while ((found = replayLoad(engine, &reader)) && g < wanted)
+        g++;
+    closeReplay(&reader);
+    if (!found)
+    {
+        printf("%s has only %ld games\n", argv[2], g);
+        freeReplayEngine(engine);
+        return 1;
+    }
 
+    int turn = argc > 4 ? atoi(argv[4]) : engine->turnCount;
+    replaySeek(engine, turn < 0 ? 0 : turn);
+    ReplayGame *game = &engine->game;
+    printf("game %ld, seed %llu: %s vs %s, %s moves first, winner: %s\n", wanted, (unsigned long long)game->seed,
+           game->difficulty[0] < 0 ? "Human" : difficultyName(game->difficulty[0]),
+           game->difficulty[1] < 0 ? "Human" : difficultyName(game->difficulty[1]),
+           game->first == 0 ? "bot1" : "bot2", game->winner < 0 ? "none" : game->winner == 0 ? "bot1" : "bot2");
+    printf("after turn %d of %d", engine->turn, engine->turnCount);
+    if (engine->turn > 0)
+    {
+        ReplayTurn *last = &engine->turns[engine->turn - 1];
+        printf(": bot%d %s at %c%d, outcome %d", last->player + 1, engine->players[last->player].moves[last->move].name,
+               last->col < 0 ? '-' : 'A' + last->col, last->row < 0 ? 0 : last->row + 1, last->outcome);
+    }
+    printf("\n");
+    if (engine->mismatches > 0)
+        printf("re-simulation disagrees with the record %d times, first at turn %d\n", engine->mismatches, engine->firstMismatch);
+    for (int p = 0; p < 2; p++)
+    {
+        printf("\nbot%d, %d ships sunk:\n", p + 1, engine->players[p].shipsSunk);
+        printReplayBoard(&engine->players[p]);
+    }
+    freeReplayEngine(engine);
+    return 0;
 }
 
-int fire(Player *player, Player *opponent, int decision)
+// battleship --replay-check <file>...
+int runReplayCheck(int argc, char *argv[])
 {
-    int row = -1, col = -1;
-
-    if (player->isBot)
+    long games = 0, turns = 0, failed = 0;
+    ReplayEngine *engine = createReplayEngine();
+    double start = wallSeconds();
+    for (int f = 2; f < argc; f++)
     {
-        if (decision == 1) // target meaningfully
+        ReplayReader reader;
+        if (!openReplay(&reader, argv[f]))
         {
-            /*setCoordsMeaningfully(player, opponent, &row, &col);*/
-            setCoordsMeaningfully(player, opponent, &row, &col);
+            printf("%s is not a replay log\n", argv[f]);
+            freeReplayEngine(engine);
+            return 1;
         }
-        else // target randomly
+        while (replayLoad(engine, &reader))
         {
-            do
+            if (engine->mismatches > 0)
             {
-                row = randomCoordinate(GRID_SIZE);
-                col = randomCoordinate(GRID_SIZE);
-            } while (opponent->grid[row][col] == hit || opponent->grid[row][col] == miss);
+                if (failed++ < 10)
+                    printf("%s: game %ld (seed %llu) disagrees at turn %d\n", argv[f], games,
+                           (unsigned long long)engine->game.seed, engine->firstMismatch);
+            }
+            games++;
+            turns += engine->turnCount;
         }
+        closeReplay(&reader);
     }
-    else
-    {
-        // Human Player Logic
-        char cl;
-        int rw;
+    double seconds = wallSeconds() - start;
+    freeReplayEngine(engine);
 
-        printf("\nEnter coordinate (e.g. B3): ");
-        scanf(" %c%d", &cl, &rw);
+    printf("games: %ld, turns: %ld, games that disagree with their record: %ld\n", games, turns, failed);
+    printf("time: %.3f s, %.0f turns/sec\n", seconds, seconds > 0 ? turns / seconds : 0.0);
+    return failed > 0;
+}
 
-        row = rw - 1;
-        col = cl - 'A';
+/*--------------------------------------------------------------Self-Test-------------------------------------------------------------------*/
 
-        if (row < 0 || row >= GRID_SIZE || col < 0 || col >= GRID_SIZE)
-        {
-            printf("\nInvalid coordinates! You lose your turn :(\n");
-            return 0;
-        }
+#define SELF_TEST_GAMES 200
+#define SELF_TEST_SEQUENCES 4           // random move sequences tried at every position
+#define SELF_TEST_DEPTH 10              // longest sequence, unwound all at once
+#define SELF_TEST_CONFIGURATIONS 8      // endgames checked against the exhaustive reference
+#define SELF_TEST_REFERENCE_NODES 20000 // its budget per position: the ones it cannot finish are skipped
+
+// battleship --self-test [games] [seed]: invariants no single game shows, checked on positions from
+// bot games of every pairing. Exits 1 if any check fails
+int runSelfTest(int argc, char *argv[])
+{
+    long games = argc > 2 ? atol(argv[2]) : SELF_TEST_GAMES;
+    uint64_t seed = argc > 3 ? strtoull(argv[3], NULL, 10) : 1;
+    if (games <= 0)
+    {
+        printUsage(argv[0]);
+        return 1;
     }
 
-    // Fire at the chosen coordinates
-    int cell = opponent->grid[row][col];
-    
-    if (cell > 1)
+    BenchPosition *snapshot = (BenchPosition *)malloc(sizeof(BenchPosition));
+    countAllocation();
+    UndoStack *stack = (UndoStack *)malloc(sizeof(UndoStack));
+    countAllocation();
+    if (snapshot == NULL || stack == NULL)
     {
-        opponent->grid[row][col] = hit;
-        if (player->isBot)
+        printf("Failed to allocate needed memory\n");
+        exit(1);
+    }
+    memset(snapshot, 0, sizeof(BenchPosition));
+    linkBenchPosition(snapshot);
+    stack->depth = 0;
+    EndgameSolver *solver = createEndgameSolver(NULL);
+    EndgameConfig config = {SELF_TEST_CONFIGURATIONS, 0, 0}; // no budget: the search has to finish
+
+    long positions = 0, moves = 0, failed = 0;
+    long endgames = 0, endgamesFailed = 0, endgamesSkipped = 0;
+    Arena arena = createArena(GAME_ARENA_BYTES);
+    Rng tests; // the moves tried, apart from the games' own stream
+    rngSeed(&tests, seed ^ 0x5E1F7E57ULL);
+    for (long g = 0; g < games; g++)
+    {
+        Rng rng;
+        rngSeed(&rng, gameSeed(seed, 0, g));
+        arenaReset(&arena);
+        Player bots[2] = {createBotPlayer(g % BOT_DIFFICULTIES, &arena),
+                          createBotPlayer(g / BOT_DIFFICULTIES % BOT_DIFFICULTIES, &arena)};
+        Player *players[2] = {&bots[0], &bots[1]};
+        for (int p = 0; p < 2; p++)
         {
-            addCell(&(player->botHitList->head), row, col);
+            bots[p].silent = 1;
+            bots[p].rng = &rng;
+            placeShips(&bots[p]);
         }
-        printf("\nResult: hit!\n");
-
-        // Decrement the ship's remaining hits
-        for (int j = 0; j < SHIPS_COUNT; j++)
+        for (int t = 0; t < MAX_HEADLESS_TURNS && bots[0].shipsSunk < SHIPS_COUNT && bots[1].shipsSunk < SHIPS_COUNT; t++)
         {
-            if (strcmpIgnoreNull(opponent->ships[j].name, getShipName(cell)))
+            long bad = checkMakeUnmake(players, t % 2, snapshot, stack, &tests, &moves);
+            if (bad > 0 && failed++ < 10)
+                printf("game %ld, turn %d: doMove/undoMove did not restore the position\n", g, t);
+            positions++;
+
+            // the solver's bounds and memo against plain expectimax
+            int move, row, col;
+            if (endgameEnumerate(solver, &bots[t % 2], &bots[1 - t % 2], SELF_TEST_CONFIGURATIONS) > 1 &&
+                endgameSolve(solver, &bots[t % 2], &bots[1 - t % 2], &config, &move, &row, &col))
             {
-                opponent->ships[j].remainingHits--;
+                int counts[MOVES_COUNT];
+                for (int m = 0; m < MOVES_COUNT; m++)
+                    counts[m] = bots[t % 2].moves[m].countAvailable;
+                uint64_t subset = (1ULL << solver->count) - 1;
+                long nodes = SELF_TEST_REFERENCE_NODES;
+                double expected = endgameReference(solver, subset, bots[1 - t % 2].board.hits, counts, bots[1 - t % 2].shipsSunk, &nodes);
+                if (expected < 0)
+                    endgamesSkipped++;
+                else
+                {
+                    if (fabs(solver->expected - expected) > 1e-9 && endgamesFailed++ < 10)
+                        printf("game %ld, turn %d: the endgame solver expects %.6f shots, exhaustive search %.6f\n", g, t,
+                               solver->expected, expected);
+                    endgames++;
+                }
             }
+            if (makeMove(&bots[t % 2], &bots[1 - t % 2]))
+                updateGameState(&bots[1 - t % 2], &bots[t % 2]);
         }
+        freeAll(&bots[0]);
+        freeAll(&bots[1]);
     }
-    else
-    {
-        if (cell != hit)
-        {
-            opponent->grid[row][col] = miss;
-        }
-        printf("\nResult: miss!\n");
-    }
-    return 1;
+    freeArena(&arena);
+    free(solver);
+    free(stack);
+    free(snapshot);
+
+    printf("seed: %llu\n", (unsigned long long)seed);
+    printf("doMove/undoMove: %ld moves at %ld positions, up to %d deep, positions not restored: %ld\n", moves, positions,
+           SELF_TEST_DEPTH, failed);
+    printf("endgame solver: %ld positions of 2 to %d configurations (%ld too large to check), disagreeing with exhaustive search: %ld\n",
+           endgames, SELF_TEST_CONFIGURATIONS, endgamesSkipped, endgamesFailed);
+    return failed > 0 || endgamesFailed > 0;
 }
 
-int radarSweep(Player *player, Player *opponent)
+// random legal moves at random targets, stacked and then unwound, must leave both players as they
+// were. Every other sequence is played as a human's, which takes the checkOneRoundMoves() path
+long checkMakeUnmake(Player *players[2], int current, BenchPosition *snapshot, UndoStack *stack, Rng *rng, long *moves)
 {
-    int row = -1, col = -1;
+    Player *player = players[current];
+    Player *opponent = players[1 - current];
+    for (int p = 0; p < 2; p++)
+        copyPlayerState(&snapshot->players[p], players[p]);
 
-    if (player->isBot)
-    {   
-        if (player->botHitList->head != NULL)
-        {   
-
-            do
-            {
-                chooseTopLeftMeaningfully(player->botHitList->head, player->radaredList->head, &row, &col);
-            } while (opponent->grid[row][col] == hit || opponent->grid[row][col] == miss);
-        }
-        // randomly select a valid top-left coordinate
-        else
+    long bad = 0;
+    for (int sequence = 0; sequence < SELF_TEST_SEQUENCES; sequence++)
+    {
+        int isBot = player->isBot;
+        player->isBot = sequence % 2 == 0;
+        int depth = 1 + rngBounded(rng, SELF_TEST_DEPTH);
+        for (int d = 0; d < depth && opponent->shipsSunk < SHIPS_COUNT; d++)
         {
+            int move;
             do
-            {
-                row = randomCoordinate(GRID_SIZE - 1);
-                col = randomCoordinate(GRID_SIZE - 1);
-                
-            } while (opponent->grid[row][col] == hit || opponent->grid[row][col] == miss);
+                move = rngBounded(rng, MOVES_COUNT);
+            while (player->moves[move].countAvailable == 0);
+            int row = randomCoordinate(rng, move == 0 || move == 4 ? GRID_SIZE : GRID_SIZE - 1);
+            int col = randomCoordinate(rng, move == 0 || move == 4 ? GRID_SIZE : GRID_SIZE - 1);
+            if (move == 4) // a row or a column, see moveTarget()
+                *(rngBounded(rng, 2) ? &row : &col) = -1;
+            doMove(player, opponent, move, row, col, stack);
+            (*moves)++;
         }
+        while (stack->depth > 0)
+            undoMove(player, opponent, stack);
+        player->isBot = isBot;
+        bad += !samePlayerState(player, &snapshot->players[current]) || !samePlayerState(opponent, &snapshot->players[1 - current]);
     }
-    else
-    {
-        // Human Player Logic
-        char cl;
-        int rw;
+    return bad;
+}
 
-        printf("\nEnter top-left coordinate (e.g. B3): ");
-        scanf(" %c%d", &cl, &rw);
+int samePlayerState(Player *a, Player *b)
+{
+    if (memcmp(&a->board, &b->board, sizeof(Board)) != 0 || a->shipsSunk != b->shipsSunk || a->sinking != b->sinking ||
+        a->lastMove != b->lastMove || a->sunkSeen != b->sunkSeen || memcmp(&a->sunkCells, &b->sunkCells, sizeof(Bitboard)) != 0)
+        return 0;
+    for (int k = 0; k < SHIPS_COUNT; k++)
+    {
+        if (a->ships[k].remainingHits != b->ships[k].remainingHits)
+            return 0;
+    }
+    for (int m = 0; m < MOVES_COUNT; m++)
+    {
+        if (a->moves[m].countAvailable != b->moves[m].countAvailable)
+            return 0;
+    }
+    return !a->isBot || (sameCellSet(a->botsShipsCoord, b->botsShipsCoord) && sameCellSet(a->botHitList, b->botHitList) &&
+                         sameCellSet(a->radaredList, b->radaredList) && sameCellSet(a->foundShips, b->foundShips));
+}
 
-        row = rw - 1;
-        col = cl - 'A';
+int sameCellSet(CellSet *a, CellSet *b) // cells past count are left over from truncation
+{
+    return a->count == b->count && memcmp(&a->members, &b->members, sizeof(Bitboard)) == 0 && memcmp(a->cells, b->cells, a->count) == 0;
+}
 
-        if (!validTopLeftCoordinate(row, col))
-        {
-            return 0;
-        }
+// the game endgameSearch() plays, written out the slow way: every move at every target that tells
+// something, every outcome weighted by its fleets, no bounds, no memo, no symmetry. Up to 64 configurations
+double endgameReference(EndgameSolver *solver, uint64_t subset, Bitboard hits, int counts[], int shipsSunk, long *nodes)
+{
+    if (--*nodes < 0)
+        return -1;
+    double total = 0;
+    for (int c = 0; c < solver->count; c++)
+    {
+        if ((subset >> c) & 1)
+            total += solver->weight[c];
     }
 
-    // Radar Sweep Logic
-    for (int i = 0; i < 2; i++)
+    double best = HUGE_VAL;
+    for (int move = 0; move < MOVES_COUNT; move++)
     {
-        for (int j = 0; j < 2; j++)
+        if (move == 2 || (move != 0 && counts[move] <= 0) || (move == 1 && !solver->radar)) // smoke tells nothing
+            continue;
+        int targets = move == 0 ? GRID_SIZE * GRID_SIZE : move == 4 ? 2 * GRID_SIZE : (GRID_SIZE - 1) * (GRID_SIZE - 1);
+        for (int i = 0; i < targets; i++)
         {
-            if (row + i >= 0 && row + i < GRID_SIZE &&
-                col + j >= 0 && col + j < GRID_SIZE)
+            Bitboard target;
+            if (move == 0)
+                target = bbCell(i / GRID_SIZE, i % GRID_SIZE);
+            else if (move == 4)
+                target = i < GRID_SIZE ? bbRow(i) : bbColumn(i - GRID_SIZE);
+            else
+                target = bbSquare(i / (GRID_SIZE - 1), i % (GRID_SIZE - 1));
+
+            // configurations grouped by what the move shows: the cells found and the ships sunk
+            uint64_t group[64];
+            Bitboard found[64];
+            int sinks[64];
+            int outcomes = 0;
+            for (int c = 0; c < solver->count; c++)
             {
-                int gridSymbol = opponent->grid[row + i][col + j];
-                if (player->isBot && !inList(player->radaredList->head, row + i, col + j))
+                if (!((subset >> c) & 1))
+                    continue;
+                Bitboard cells = bbAnd(bbAndNot(target, hits), solver->fleet[c]);
+                int sink = 0;
+                for (int j = 0; move != 1 && j < solver->afloatCount; j++)
+                {
+                    if (bbAny(bbAndNot(solver->ship[c][j], hits)) && !bbAny(bbAndNot(solver->ship[c][j], bbOr(hits, cells))))
+                        sink |= 1 << j;
+                }
+                int o = 0;
+                while (o < outcomes && !(found[o].lo == cells.lo && found[o].hi == cells.hi && sinks[o] == sink))
+                    o++;
+                if (o == outcomes)
                 {
-                    addCell(&(player->radaredList->head), row + i, col + j);
+                    found[o] = cells;
+                    sinks[o] = sink;
+                    group[o] = 0;
+                    outcomes++;
                 }
-                if (gridSymbol != hit && gridSymbol != miss && gridSymbol != empty)
+                group[o] |= 1ULL << c;
+            }
+            if (outcomes == 1 && (move == 1 || !bbAny(found[0]))) // learns nothing, changes nothing
+                continue;
+
+            double value = 1;
+            for (int o = 0; o < outcomes; o++)
+            {
+                double weight = 0;
+                int first = -1;
+                for (int c = 0; c < solver->count; c++)
                 {
-                    if (inList(opponent->smokedCells->head, row + i, col + j) == 0)
+                    if ((group[o] >> c) & 1)
                     {
-                        if (!(player->isBot))
-                        {
-                            printf("\nResult: enemy ships found!\n");
-                            return 1;
-                        }
-                        else
-                        {
-                            addCell(&(player->foundShips->head), row + i, col + j);
-                        }
+                        weight += solver->weight[c];
+                        if (first < 0)
+                            first = c;
                     }
                 }
+                Bitboard known = move == 1 ? hits : bbOr(hits, found[o]);
+                int afloat = 0;
+                for (int j = 0; j < solver->afloatCount; j++)
+                    afloat += bbAny(bbAndNot(solver->ship[first][j], known));
+                if (afloat == 0)
+                    continue;
+                int next[MOVES_COUNT];
+                int sunk = endgameCounts(counts, move, sinks[o], shipsSunk, next);
+                double rest = endgameReference(solver, group[o], known, next, sunk, nodes);
+                if (rest < 0)
+                    return -1;
+                value += weight / total * rest;
             }
+            if (value < best)
+                best = value;
         }
     }
-    if (!(player->isBot))
-    {
-        printf("\nResult: no enemy ships found!\n");
-        return 1;
-    }
-    return 1;
+    return best;
 }
 
-int smokeScreen(Player *player, Player *opponent)
-{
-    int row = -1, col = -1;
+/*-------------------------------------------------------------Batch Engine-----------------------------------------------------------------*/
 
-    if (player->isBot)
+// Both engines below play the same games: bots without memory that strike with torpedo, else artillery,
+// else fire, aimed like the random branch of fire(), artillery() and torpedo(). The bots' own target
+// choice does not vectorize; what does is resolving the strikes and the sinks, which runBatch() does
+// for all its lanes at once. playPlayerGame(seed), playPackedGame(seed) and game g of runBatch() for
+// the same seed agree on every result. None of them is a tournament engine: the bots do not target.
+int randomStrike(Rng *rng, int torpedoes, int artilleries, Bitboard discovered, Bitboard *target)
+{
+    int row, col;
+    if (torpedoes != 0)
     {
-        chooseTopLeftMeaningfully(player->botsShipsCoord->head, player->smokedCells->head, &row, &col);
+        int isRow = rngBounded(rng, 2);
+        int line = randomCoordinate(rng, GRID_SIZE);
+        *target = isRow ? bbRow(line) : bbColumn(line);
+        return 4;
     }
-    else
+    if (artilleries != 0)
     {
-        // Human Player Logic
-        char cl;
-        int rw;
-
-        printf("\nEnter top-left coordinate (e.g. B3): ");
-        scanf(" %c%d", &cl, &rw);
-
-        row = rw - 1;
-        col = cl - 'A';
-
-        if (!validTopLeftCoordinate(row, col))
+        int tries = 0;
+        do
         {
-            // printf("\nInvalid coordinates! You lose your turn :(\n");
-            return 0;
-        }
+            row = randomCoordinate(rng, GRID_SIZE - 1);
+            col = randomCoordinate(rng, GRID_SIZE - 1);
+        } while (bbTest(discovered, row, col) && ++tries < GRID_SIZE * GRID_SIZE);
+        *target = bbSquare(row, col);
+        return 3;
     }
+    // a uniform undiscovered cell, like fire() retrying, without the retries late in the game
+    Bitboard open = bbAndNot(bbFull(), discovered);
+    int cell = bbNth(open, rngBounded(rng, bbCount(open)));
+    *target = bbCell(cell / GRID_SIZE, cell % GRID_SIZE);
+    return 0;
+}
 
-    // Perform Smoke Screen Logic
-    for (int i = 0; i < 2; i++)
+GameResult playPackedGame(uint64_t seed)
+{
+    GameResult result;
+    memset(&result, 0, sizeof(result));
+    result.winner = -1;
+    result.seed = seed;
+
+    PackedGame game;
+    memset(&game, 0, sizeof(game));
+    rngSeed(&game.rng, seed);
+    packedPlaceFleet(&game.players[0], &game.rng);
+    packedPlaceFleet(&game.players[1], &game.rng);
+
+    int current = rngBounded(&game.rng, 2);
+    while (result.turns < MAX_HEADLESS_TURNS)
     {
-        for (int j = 0; j < 2; j++)
+        PackedPlayer *player = &game.players[current];
+        PackedPlayer *opponent = &game.players[1 - current];
+        result.turns++;
+
+        Bitboard target;
+        int move = randomStrike(&game.rng, player->countAvailable[4], player->countAvailable[3],
+                                bbOr(opponent->hits, opponent->misses), &target);
+        if (player->countAvailable[move] > 0)
+            player->countAvailable[move]--;
+        result.movesUsed[current][move]++;
+        packedStrike(opponent, target);
+        packedUpdateSinks(opponent, player);
+
+        if (opponent->shipsSunk == SHIPS_COUNT)
         {
-            int gridSymbol = player->grid[row + i][col + j];
-            if (gridSymbol != hit && gridSymbol != miss && gridSymbol != empty)
-            {
-                if (inList(player->smokedCells->head, row + i, col + j) == 0)
-                {
-                    addCell(&(player->smokedCells->head), col + j, row + i);
-                }
-            }
+            result.winner = current;
+            break;
         }
+        current = 1 - current;
     }
-    if (!(player->isBot))
-    {
-        getchar();
-        printf("\nSMOKE SCREEN performed! Press enter to proceed \n");
-        getchar();
-        system("cls");
-    }
-    return 1;
+    return result;
 }
 
-int artillery(Player *player, Player *opponent, int decision)
+// the headless engine's Player state and move rules (strike(), sinks, move unlocks), with the batch
+// engine's targets
+GameResult playPlayerGame(uint64_t seed, Arena *arena)
 {
-    int row = -1, col = -1;
+    GameResult result;
+    memset(&result, 0, sizeof(result));
+    result.winner = -1;
+    result.seed = seed;
+
+    Rng rng;
+    rngSeed(&rng, seed);
+    Player players[2];
+    arenaReset(arena);
+    for (int p = 0; p < 2; p++)
+    {
+        players[p] = createBotPlayer(easyBot, arena);
+        players[p].silent = 1;
+        players[p].rng = &rng;
+        botPlaceFleet(&players[p]); // same draws as playPackedGame()
+    }
 
-    if (player->isBot)
+    int current = rngBounded(&rng, 2);
+    while (result.turns < MAX_HEADLESS_TURNS)
     {
-        if (decision == 1) // target meaningfully
-        {
-            do
-            {
-                setCoordsMeaningfully(player, opponent, &row, &col);
-            } while (!(row < 9 && row >= 0 && col < 9 && col >= 0));
-        }
-        else // target randomly
+        Player *player = &players[current];
+        Player *opponent = &players[1 - current];
+        result.turns++;
+
+        Bitboard target;
+        int move = randomStrike(&rng, player->moves[4].countAvailable, player->moves[3].countAvailable,
+                                bbOr(opponent->board.hits, opponent->board.misses), &target);
+        strike(player, opponent, target);
+        if (player->moves[move].countAvailable > 0)
+            player->moves[move].countAvailable--;
+        player->lastMove = move;
+        result.movesUsed[current][move]++;
+        updateGameState(opponent, player);
+
+        if (opponent->shipsSunk == SHIPS_COUNT)
         {
-            do
-            {
-                row = randomCoordinate(GRID_SIZE - 1);
-                col = randomCoordinate(GRID_SIZE - 1);
-            } while (opponent->grid[row][col] == hit || opponent->grid[row][col] == miss);
+            result.winner = current;
+            break;
         }
+        current = 1 - current;
     }
-    else
+    freeAll(&players[0]);
+    freeAll(&players[1]);
+    return result;
+}
+
+// a fresh player, as createPlayer() and botPlaceFleet() leave it
+void packedPlaceFleet(PackedPlayer *player, Rng *rng)
+{
+    Fleet fleet;
+    sampleFleet(rng, &fleet);
+    packFleet(player, &fleet);
+}
+
+void packFleet(PackedPlayer *player, Fleet *fleet)
+{
+    memset(player, 0, sizeof(PackedPlayer));
+    for (int k = 0; k < SHIPS_COUNT; k++)
     {
-        // Human Player Logic
-        char cl;
-        int rw;
+        player->placement[k] = fleet->placement[k];
+        player->remainingHits[k] = (signed char)(k + 2);
+    }
+    player->ships = fleetMask(fleet);
+    for (int m = 0; m < MOVES_COUNT; m++)
+        player->countAvailable[m] = (signed char)initialMoveCounts[m];
+    player->lastMove = -1;
+    player->difficulty = -1;
+}
 
-        printf("\nEnter top-left coordinate (e.g. B3): ");
-        scanf(" %c%d", &cl, &rw);
+void runBatch(long games, uint64_t seed, GameResult results[])
+{
+    BatchEngine *engine = (BatchEngine *)malloc(sizeof(BatchEngine));
+    countAllocation();
+    if (engine == NULL)
+    {
+        printf("Failed to allocate needed memory\n");
+        exit(1);
+    }
+    memset(engine, 0, sizeof(BatchEngine));
+    for (int i = 0; i < BATCH_LANES; i++)
+    {
+        engine->game[i] = -1;
+        for (int k = 0; k < SHIPS_COUNT; k++) // idle lanes have nothing left to sink
+            engine->sides[0].remainingHits[k][i] = engine->sides[1].remainingHits[k][i] = -1;
+    }
+    engine->games = games;
+    engine->seed = seed;
 
-        row = rw - 1;
-        col = cl - 'A';
+    while (1)
+    {
+        batchRefill(engine, results);
+        int active = 0;
+        for (int i = 0; i < BATCH_LANES; i++)
+            active += engine->game[i] >= 0;
+        if (active == 0)
+            break;
+        batchStep(engine, results);
+    }
+    free(engine);
+}
 
-        if (!validTopLeftCoordinate(row, col))
-        {
-            // printf("\nInvalid coordinates! You lose your turn :(\n");
-            return 0;
-        }
+// idle lanes take the next games of the queue
+void batchRefill(BatchEngine *engine, GameResult results[])
+{
+    for (int i = 0; i < BATCH_LANES && engine->next < engine->games; i++)
+    {
+        if (engine->game[i] >= 0)
+            continue;
+        long g = engine->next++;
+        GameResult *result = &results[g];
+        memset(result, 0, sizeof(GameResult));
+        result->winner = -1;
+        result->seed = gameSeed(engine->seed, 0, g);
+
+        Rng *rng = &engine->rng[i];
+        Fleet fleets[2];
+        rngSeed(rng, result->seed);
+        sampleFleet(rng, &fleets[0]); // same draws as playPackedGame()
+        sampleFleet(rng, &fleets[1]);
+        int current = rngBounded(rng, 2);
+
+        // the starting player goes to the side that moves next
+        engine->first[i] = current ^ (int)(engine->step & 1);
+        batchLoadFleet(&engine->sides[0], i, &fleets[engine->first[i]]);
+        batchLoadFleet(&engine->sides[1], i, &fleets[1 - engine->first[i]]);
+        engine->game[i] = g;
     }
-        
-    
+}
 
-    // Artillery Logic
-    int h = 0; // Number of hits
-    for (int i = 0; i < 2; i++)
+void batchLoadFleet(BatchSide *side, int lane, Fleet *fleet)
+{
+    Bitboard ships = fleetMask(fleet);
+    side->shipsLo[lane] = ships.lo;
+    side->shipsHi[lane] = ships.hi;
+    side->hitsLo[lane] = side->hitsHi[lane] = 0;
+    side->missesLo[lane] = side->missesHi[lane] = 0;
+    for (int k = 0; k < SHIPS_COUNT; k++)
     {
-        for (int j = 0; j < 2; j++)
-        {
-            int gridSymbol = opponent->grid[row + i][col + j];
-            if (gridSymbol > 1)
-            {
-                opponent->grid[row + i][col + j] = hit;
-                h++;
-                if (player->isBot)
-                {
-                    addCell(&(player->botHitList->head), row + i, col + j);
-                }
-                for (int k = 0; k < SHIPS_COUNT; k++)
-                {
-                    if (strcmpIgnoreNull(opponent->ships[k].name, getShipName(gridSymbol)))
-                    {
-                        opponent->ships[k].remainingHits--;
-                    }
-                }
-            }
-            else
-            {
-                if (gridSymbol != hit)
-                {
-                    opponent->grid[row + i][col + j] = miss;
-                }
-            }
-        }
+        Bitboard mask = placements.mask[k][fleet->placement[k]];
+        side->maskLo[k][lane] = mask.lo;
+        side->maskHi[k][lane] = mask.hi;
+        side->remainingHits[k][lane] = k + 2;
     }
-    if (h > 0)
+    for (int m = 0; m < MOVES_COUNT; m++)
+        side->countAvailable[m][lane] = initialMoveCounts[m];
+    side->shipsSunk[lane] = 0;
+}
+
+// one turn of every active lane: choose the targets lane by lane, resolve them all at once,
+// then retire the games that ended
+void batchStep(BatchEngine *engine, GameResult results[])
+{
+    int moving = (int)(engine->step & 1);
+    BatchSide *player = &engine->sides[moving];
+    BatchSide *opponent = &engine->sides[1 - moving];
+
+    for (int i = 0; i < BATCH_LANES; i++)
     {
-        printf("\nResult: hit!\n");
+        engine->targetLo[i] = engine->targetHi[i] = 0;
+        if (engine->game[i] < 0)
+            continue;
+        GameResult *result = &results[engine->game[i]];
+        result->turns++;
+
+        Bitboard discovered = {opponent->hitsLo[i] | opponent->missesLo[i], opponent->hitsHi[i] | opponent->missesHi[i]};
+        Bitboard target;
+        int move = randomStrike(&engine->rng[i], (int)player->countAvailable[4][i], (int)player->countAvailable[3][i],
+                                discovered, &target);
+        if (player->countAvailable[move][i] > 0)
+            player->countAvailable[move][i]--;
+        result->movesUsed[engine->first[i] ^ moving][move]++;
+        engine->targetLo[i] = target.lo;
+        engine->targetHi[i] = target.hi;
     }
-    else
+
+    batchResolve(opponent, player, engine->targetLo, engine->targetHi);
+
+    for (int i = 0; i < BATCH_LANES; i++)
     {
-        printf("\nResult: miss!\n");
+        if (engine->game[i] < 0)
+            continue;
+        GameResult *result = &results[engine->game[i]];
+        if (opponent->shipsSunk[i] == SHIPS_COUNT)
+            result->winner = engine->first[i] ^ moving;
+        if (opponent->shipsSunk[i] == SHIPS_COUNT || result->turns >= MAX_HEADLESS_TURNS)
+            engine->game[i] = -1; // refilled before the next step
     }
-    return 1;
+    engine->step++;
 }
 
-int torpedo(Player *player, Player *opponent, int decision)
+#ifdef __AVX2__
+__m256i popcount256(__m256i x) // per 64-bit lane: nibble lookup, then byte sums
 {
-    int row = -1;
-    int col = -1;
+    const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                           0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    __m256i low = _mm256_shuffle_epi8(table, _mm256_and_si256(x, nibble));
+    __m256i high = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi64(x, 4), nibble));
+    return _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256());
+}
+#endif
 
-    if (player->isBot)
+// strike() and updateGameState() of every lane: new hits, misses, remaining hits, sinks and the
+// moves they unlock. Idle lanes strike nothing, which changes nothing.
+void batchResolve(BatchSide *opponent, BatchSide *player, uint64_t targetLo[], uint64_t targetHi[])
+{
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+    for (int i = 0; i < BATCH_LANES; i += 8)
     {
-        if (decision == 1)          // target meaningfully
-        {                           // BRUTEFORCE
-            int isRow = rand() % 2; // Randomly choose between row or column
-            setCoordsMeaningfully(player, opponent, &row, &col);
-            if (isRow)
-            {
-                col = -1;
-            }
-            else
+        __m512i tLo = _mm512_loadu_si512(&targetLo[i]);
+        __m512i tHi = _mm512_loadu_si512(&targetHi[i]);
+        __m512i shipsLo = _mm512_loadu_si512(&opponent->shipsLo[i]);
+        __m512i shipsHi = _mm512_loadu_si512(&opponent->shipsHi[i]);
+        __m512i hitsLo = _mm512_loadu_si512(&opponent->hitsLo[i]);
+        __m512i hitsHi = _mm512_loadu_si512(&opponent->hitsHi[i]);
+        __m512i newLo = _mm512_andnot_si512(hitsLo, _mm512_and_si512(tLo, shipsLo));
+        __m512i newHi = _mm512_andnot_si512(hitsHi, _mm512_and_si512(tHi, shipsHi));
+        _mm512_storeu_si512(&opponent->hitsLo[i], _mm512_or_si512(hitsLo, newLo));
+        _mm512_storeu_si512(&opponent->hitsHi[i], _mm512_or_si512(hitsHi, newHi));
+        _mm512_storeu_si512(&opponent->missesLo[i], _mm512_or_si512(_mm512_loadu_si512(&opponent->missesLo[i]), _mm512_andnot_si512(shipsLo, tLo)));
+        _mm512_storeu_si512(&opponent->missesHi[i], _mm512_or_si512(_mm512_loadu_si512(&opponent->missesHi[i]), _mm512_andnot_si512(shipsHi, tHi)));
+
+        const __m512i one = _mm512_set1_epi64(1);
+        __m512i sunk = _mm512_loadu_si512(&opponent->shipsSunk[i]);
+        for (int k = 0; k < SHIPS_COUNT; k++) // in ship order, like updateGameState()
+        {
+            __m512i hits = _mm512_add_epi64(_mm512_popcnt_epi64(_mm512_and_si512(newLo, _mm512_loadu_si512(&opponent->maskLo[k][i]))),
+                                            _mm512_popcnt_epi64(_mm512_and_si512(newHi, _mm512_loadu_si512(&opponent->maskHi[k][i]))));
+            __m512i remaining = _mm512_sub_epi64(_mm512_loadu_si512(&opponent->remainingHits[k][i]), hits);
+            __mmask8 sinks = _mm512_cmpeq_epi64_mask(remaining, _mm512_setzero_si512());
+            _mm512_storeu_si512(&opponent->remainingHits[k][i], _mm512_mask_mov_epi64(remaining, sinks, _mm512_set1_epi64(-1)));
+            if (!sinks)
+                continue;
+            sunk = _mm512_mask_add_epi64(sunk, sinks, sunk, one);
+            for (int m = 0; m < MOVES_COUNT; m++) // updateMoves()
             {
-                row = -1;
+                __m512i count = _mm512_loadu_si512(&player->countAvailable[m][i]);
+                __mmask8 unlock = sinks & _mm512_cmple_epi64_mask(_mm512_set1_epi64(moveUnlockThresholds[m]), sunk) &
+                                  _mm512_cmpge_epi64_mask(count, _mm512_setzero_si512());
+                _mm512_storeu_si512(&player->countAvailable[m][i], _mm512_mask_add_epi64(count, unlock, count, one));
             }
         }
-        else // target randomly
+        _mm512_storeu_si512(&opponent->shipsSunk[i], sunk);
+    }
+#elif defined(__AVX2__)
+    for (int i = 0; i < BATCH_LANES; i += 4)
+    {
+        __m256i tLo = _mm256_loadu_si256((__m256i *)&targetLo[i]);
+        __m256i tHi = _mm256_loadu_si256((__m256i *)&targetHi[i]);
+        __m256i shipsLo = _mm256_loadu_si256((__m256i *)&opponent->shipsLo[i]);
+        __m256i shipsHi = _mm256_loadu_si256((__m256i *)&opponent->shipsHi[i]);
+        __m256i hitsLo = _mm256_loadu_si256((__m256i *)&opponent->hitsLo[i]);
+        __m256i hitsHi = _mm256_loadu_si256((__m256i *)&opponent->hitsHi[i]);
+        __m256i newLo = _mm256_andnot_si256(hitsLo, _mm256_and_si256(tLo, shipsLo));
+        __m256i newHi = _mm256_andnot_si256(hitsHi, _mm256_and_si256(tHi, shipsHi));
+        _mm256_storeu_si256((__m256i *)&opponent->hitsLo[i], _mm256_or_si256(hitsLo, newLo));
+        _mm256_storeu_si256((__m256i *)&opponent->hitsHi[i], _mm256_or_si256(hitsHi, newHi));
+        _mm256_storeu_si256((__m256i *)&opponent->missesLo[i],
+                            _mm256_or_si256(_mm256_loadu_si256((__m256i *)&opponent->missesLo[i]), _mm256_andnot_si256(shipsLo, tLo)));
+        _mm256_storeu_si256((__m256i *)&opponent->missesHi[i],
+                            _mm256_or_si256(_mm256_loadu_si256((__m256i *)&opponent->missesHi[i]), _mm256_andnot_si256(shipsHi, tHi)));
+
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i sunk = _mm256_loadu_si256((__m256i *)&opponent->shipsSunk[i]);
+        for (int k = 0; k < SHIPS_COUNT; k++) // in ship order, like updateGameState()
         {
-            int isRow = rand() % 2; // Randomly choose between row or column
-            if (isRow)
+            __m256i hits = _mm256_add_epi64(popcount256(_mm256_and_si256(newLo, _mm256_loadu_si256((__m256i *)&opponent->maskLo[k][i]))),
+                                            popcount256(_mm256_and_si256(newHi, _mm256_loadu_si256((__m256i *)&opponent->maskHi[k][i]))));
+            __m256i remaining = _mm256_sub_epi64(_mm256_loadu_si256((__m256i *)&opponent->remainingHits[k][i]), hits);
+            __m256i sinks = _mm256_cmpeq_epi64(remaining, zero); // all ones in the lanes that sink ship k
+            _mm256_storeu_si256((__m256i *)&opponent->remainingHits[k][i], _mm256_or_si256(remaining, sinks)); // 0 becomes -1
+            if (_mm256_testz_si256(sinks, sinks))
+                continue;
+            sunk = _mm256_sub_epi64(sunk, sinks);
+            for (int m = 0; m < MOVES_COUNT; m++) // updateMoves()
             {
-                row = randomCoordinate(GRID_SIZE);
+                __m256i count = _mm256_loadu_si256((__m256i *)&player->countAvailable[m][i]);
+                __m256i locked = _mm256_or_si256(_mm256_cmpgt_epi64(_mm256_set1_epi64x(moveUnlockThresholds[m]), sunk),
+                                                 _mm256_cmpgt_epi64(zero, count));
+                _mm256_storeu_si256((__m256i *)&player->countAvailable[m][i], _mm256_sub_epi64(count, _mm256_andnot_si256(locked, sinks)));
             }
-            else
+        }
+        _mm256_storeu_si256((__m256i *)&opponent->shipsSunk[i], sunk);
+    }
+#else
+    for (int i = 0; i < BATCH_LANES; i++)
+    {
+        uint64_t newLo = targetLo[i] & opponent->shipsLo[i] & ~opponent->hitsLo[i];
+        uint64_t newHi = targetHi[i] & opponent->shipsHi[i] & ~opponent->hitsHi[i];
+        opponent->hitsLo[i] |= newLo;
+        opponent->hitsHi[i] |= newHi;
+        opponent->missesLo[i] |= targetLo[i] & ~opponent->shipsLo[i];
+        opponent->missesHi[i] |= targetHi[i] & ~opponent->shipsHi[i];
+        for (int k = 0; k < SHIPS_COUNT; k++)
+        {
+            opponent->remainingHits[k][i] -= popcount64(newLo & opponent->maskLo[k][i]) + popcount64(newHi & opponent->maskHi[k][i]);
+            if (opponent->remainingHits[k][i] != 0)
+                continue;
+            opponent->remainingHits[k][i] = -1;
+            opponent->shipsSunk[i]++;
+            for (int m = 0; m < MOVES_COUNT; m++)
             {
-                col = randomCoordinate(GRID_SIZE);
+                if (moveUnlockThresholds[m] <= opponent->shipsSunk[i] && player->countAvailable[m][i] >= 0)
+                    player->countAvailable[m][i]++;
             }
         }
     }
-    else
+#endif
+}
+
+const char *batchInstructionSet()
+{
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+    return "avx512";
+#elif defined(__AVX2__)
+    return "avx2";
+#else
+    return "scalar";
+#endif
+}
+
+/*-------------------------------------------------------------Benchmarks-------------------------------------------------------------------*/
+
+#define BENCH_POSITIONS 64 // kernels cycle through this many positions
+#define BENCH_KERNELS 13
+#define ENDGAME_BANDS 6
+#define ENDGAME_BENCH_POSITIONS 16 // per band
+#define ENDGAME_BENCH_GAMES 5000   // at most, the wider bands fill up long before
+
+// one JSON object per line, keys always in the same order, so runs diff cleanly across commits:
+// {"type":"meta",...} first, then {"type":"micro",...} per kernel, {"type":"macro",...} per pairing,
+// {"type":"batch",...} for the random-targeting games on Player state, on packed state and in lockstep, and last
+// {"type":"endgame",...} per band of configurations, see runEndgameBenchmark()
+int runBenchmark(int argc, char *argv[])
+{
+    long iterations = argc > 2 ? atol(argv[2]) : 100000;
+    long games = argc > 3 ? atol(argv[3]) : 100;
+    uint64_t seed = argc > 4 ? strtoull(argv[4], NULL, 10) : 1; // fixed by default: every run sees the same boards
+    if (iterations <= 0 || games <= 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    const char *kernelNames[BENCH_KERNELS] = {"fire", "radarSweep", "smokeScreen", "artillery", "torpedo", "botPlaceFleet",
+                                              "setCoordsMeaningfully/Hard", "setCoordsMeaningfully/Expert", "setCoordsMeaningfully/Master",
+                                              "packGame+unpackGame", "strike", "packedStrike", "doMove+undoMove"};
+    const long kernelDivisor[BENCH_KERNELS] = {1, 1, 1, 1, 1, 1, 1, 1, 1000, 1, 1, 1, 1}; // Master samples fleets on every call
+
+    BenchPosition *positions = (BenchPosition *)malloc(sizeof(BenchPosition) * BENCH_POSITIONS);
+    countAllocation();
+    if (positions == NULL)
+    {
+        printf("Failed to allocate needed memory\n");
+        exit(1);
+    }
+    UndoStack *stack = (UndoStack *)malloc(sizeof(UndoStack));
+    countAllocation();
+    if (stack == NULL)
+    {
+        printf("Failed to allocate needed memory\n");
+        exit(1);
+    }
+    stack->depth = 0;
+    Rng rng;
+    rngSeed(&rng, seed);
+    for (int i = 0; i < BENCH_POSITIONS; i++)
+        makeBenchPosition(&positions[i], &rng);
+
+    Player bot = createBotPlayer(densityBot, NULL); // has every bot field, difficulty is set per kernel
+    Player opponent = createBotPlayer(hardBot, NULL);
+    bot.silent = opponent.silent = 1;
+    bot.rng = opponent.rng = &rng;
+
+    printf("{\"type\":\"meta\",\"version\":2,\"seed\":%llu,\"iterations\":%ld,\"games\":%ld,\"positions\":%d,\"packed_game_bytes\":%d}\n",
+           (unsigned long long)seed, iterations, games, BENCH_POSITIONS, (int)sizeof(PackedGame));
+
+    double start;
+    transpositionEnabled = 0; // the kernels cycle through the same positions, the Master one would only time the cache
+    for (int kernel = 0; kernel < BENCH_KERNELS; kernel++)
+    {
+        long n = iterations / kernelDivisor[kernel] > 0 ? iterations / kernelDivisor[kernel] : 1;
+        // restoring the positions alone, right before the kernel and as often: ns_per_op is the
+        // difference, left unclamped so that noise shows
+        start = wallSeconds();
+        for (long i = 0; i < n; i++)
+        {
+            copyPlayerState(&bot, &positions[i % BENCH_POSITIONS].players[0]);
+            copyPlayerState(&opponent, &positions[i % BENCH_POSITIONS].players[1]);
+        }
+        double restoreNs = (wallSeconds() - start) * 1e9 / n;
+        start = wallSeconds();
+        for (long i = 0; i < n; i++)
+        {
+            copyPlayerState(&bot, &positions[i % BENCH_POSITIONS].players[0]);
+            copyPlayerState(&opponent, &positions[i % BENCH_POSITIONS].players[1]);
+            benchKernel(kernel, &bot, &opponent, stack);
+        }
+        double rawNs = (wallSeconds() - start) * 1e9 / n;
+        printf("{\"type\":\"micro\",\"name\":\"%s\",\"iterations\":%ld,\"ns_per_op\":%.1f,\"raw_ns\":%.1f,\"restore_ns\":%.1f}\n",
+               kernelNames[kernel], n, rawNs - restoreNs, rawNs, restoreNs);
+    }
+    transpositionEnabled = 1;
+    fflush(stdout);
+
+    Arena arena = createArena(GAME_ARENA_BYTES);
+    for (int p = 0; p < BOT_DIFFICULTIES * BOT_DIFFICULTIES; p++)
     {
-        // Human Player Logic
-        char input;
-        printf("\nEnter row (e.g. 3) or column (e.g. B): ");
-        scanf(" %c", &input);
+        long turns = 0;
+        start = wallSeconds();
+        for (long g = 0; g < games; g++)
+            turns += playHeadlessGame(p / BOT_DIFFICULTIES, p % BOT_DIFFICULTIES, gameSeed(seed, p, g), &arena, NULL).turns;
+        double seconds = wallSeconds() - start;
+        printf("{\"type\":\"macro\",\"bot1\":\"%s\",\"bot2\":\"%s\",\"games\":%ld,\"games_per_sec\":%.1f,\"turns_per_game\":%.2f,\"ns_per_turn\":%.1f}\n",
+               difficultyName(p / BOT_DIFFICULTIES), difficultyName(p % BOT_DIFFICULTIES), games,
+               games / seconds, (double)turns / games, seconds * 1e9 / turns);
+        fflush(stdout);
+    }
 
-        // Validate input
-        if (input >= 'A' && input <= 'J')
+    freeArena(&arena);
+
+    // all three engines play the same games, see randomStrike()
+    long batchGames = games * BOT_DIFFICULTIES * BOT_DIFFICULTIES;
+    GameResult *results = (GameResult *)malloc(sizeof(GameResult) * batchGames);
+    countAllocation();
+    if (results == NULL)
+    {
+        printf("Failed to allocate needed memory\n");
+        exit(1);
+    }
+    const char *engineNames[3] = {"headless", "packed", "lockstep"};
+    arena = createArena(GAME_ARENA_BYTES);
+    for (int engine = 0; engine < 3; engine++)
+    {
+        long turns = 0;
+        long mismatches = 0;
+        start = wallSeconds();
+        if (engine == 0)
         {
-            col = input - 'A';
+            for (long g = 0; g < batchGames; g++)
+                results[g] = playPlayerGame(gameSeed(seed, 0, g), &arena);
         }
-        else if (input >= '1' && input <= '9' + 1)
+        else if (engine == 1)
         {
-            row = input - '1';
+            for (long g = 0; g < batchGames; g++)
+                results[g] = playPackedGame(gameSeed(seed, 0, g));
         }
         else
         {
-            printf("\nInvalid coordinates! You lose your turn :(\n");
-            getchar();
-            return 0;
+            runBatch(batchGames, seed, results);
         }
-    }
-
-    // Perform Torpedo Logic
-    int h = 0; // Number of hits
-
-    if (col == -1)
-    { // Target a row
-        for (int i = 0; i < GRID_SIZE; i++)
+        double seconds = wallSeconds() - start;
+        for (long g = 0; g < batchGames; g++)
         {
-            int gridSymbol = opponent->grid[row][i];
-            if (gridSymbol > 1)
-            {
-                opponent->grid[row][i] = hit;
-                h++;
-                if (player->isBot)
-                {
-                    addCell(&(player->botHitList->head), row, i);
-                }
-                for (int k = 0; k < SHIPS_COUNT; k++)
-                {
-                    if (strcmpIgnoreNull(opponent->ships[k].name, getShipName(gridSymbol)))
-                    {
-                        opponent->ships[k].remainingHits--;
-                    }
-                }
-            }
-            else
+            turns += results[g].turns;
+            if (engine != 1)
             {
-                if (gridSymbol != hit)
-                {
-                    opponent->grid[row][i] = miss;
-                }
+                GameResult expected = playPackedGame(gameSeed(seed, 0, g));
+                mismatches += memcmp(&expected, &results[g], sizeof(GameResult)) != 0;
             }
         }
+        printf("{\"type\":\"batch\",\"engine\":\"%s\",\"instruction_set\":\"%s\",\"lanes\":%d,\"games\":%ld,\"games_per_sec\":%.1f,\"turns_per_game\":%.2f,\"mismatches\":%ld}\n",
+               engineNames[engine], engine < 2 ? "scalar" : batchInstructionSet(), engine < 2 ? 1 : BATCH_LANES,
+               batchGames, batchGames / seconds, (double)turns / batchGames, mismatches);
+        fflush(stdout);
     }
-    else
-    { // Target a column
-        for (int i = 0; i < GRID_SIZE; i++)
+    freeArena(&arena);
+
+    runEndgameBenchmark(seed, ENDGAME_BENCH_POSITIONS);
+
+    free(results);
+    free(stack);
+    freeAll(&bot);
+    freeAll(&opponent);
+    free(positions);
+    return 0;
+}
+
+// endgame solve time against the threshold: positions from Expert games are sorted into bands by
+// how many configurations fit, then solved within the headless node budget as if the threshold
+// were the top of their band. "solved" says how many finished in the budget
+int runEndgameBenchmark(uint64_t seed, long positions)
+{
+    const int bandTop[ENDGAME_BANDS] = {4, 8, 12, 16, 24, 32};
+    long solves[ENDGAME_BANDS] = {0}, solved[ENDGAME_BANDS] = {0}, nodes[ENDGAME_BANDS] = {0};
+    double seconds[ENDGAME_BANDS] = {0};
+    EndgameSolver *solver = createEndgameSolver(NULL);
+    EndgameConfig config = headlessEndgame;
+    config.configurations = bandTop[ENDGAME_BANDS - 1];
+
+    Rng rng;
+    long full = 0;
+    for (long g = 0; g < ENDGAME_BENCH_GAMES && full < ENDGAME_BANDS; g++)
+    {
+        rngSeed(&rng, gameSeed(seed, 0, g));
+        Player players[2] = {createBotPlayer(densityBot, NULL), createBotPlayer(densityBot, NULL)};
+        players[0].silent = players[1].silent = 1;
+        players[0].rng = players[1].rng = &rng;
+        placeShips(&players[0]);
+        placeShips(&players[1]);
+
+        for (int t = 0; t < MAX_HEADLESS_TURNS && players[0].shipsSunk < SHIPS_COUNT && players[1].shipsSunk < SHIPS_COUNT; t++)
         {
-            int gridSymbol = opponent->grid[i][col];
-            if (gridSymbol > 1)
-            {
-                opponent->grid[i][col] = hit;
-                h++;
-                if (player->isBot)
-                {
-                    addCell(&(player->botHitList->head), i, col);
-                }
-                for (int k = 0; k < SHIPS_COUNT; k++)
-                {
-                    if (strcmpIgnoreNull(opponent->ships[k].name, getShipName(gridSymbol)))
-                    {
-                        opponent->ships[k].remainingHits--;
-                    }
-                }
-            }
-            else
+            Player *player = &players[t % 2];
+            Player *opponent = &players[1 - t % 2];
+            int count = endgameEnumerate(solver, player, opponent, config.configurations);
+            int band = 0;
+            while (count > 0 && band < ENDGAME_BANDS && count > bandTop[band])
+                band++;
+            if (count > 0 && solves[band] < positions)
             {
-                if (gridSymbol != hit)
-                {
-                    opponent->grid[i][col] = miss;
-                }
+                int move, row, col;
+                double start = wallSeconds();
+                solved[band] += endgameSolve(solver, player, opponent, &config, &move, &row, &col);
+                seconds[band] += wallSeconds() - start;
+                nodes[band] += solver->nodes;
+                full += ++solves[band] == positions;
             }
+            if (makeMove(player, opponent))
+                updateGameState(opponent, player);
         }
+        freeAll(&players[0]);
+        freeAll(&players[1]);
     }
 
-    if (h > 0)
+    for (int band = 0; band < ENDGAME_BANDS; band++)
     {
-        printf("\nResult: hit!\n");
+        printf("{\"type\":\"endgame\",\"max_configurations\":%d,\"positions\":%ld,\"solved\":%ld,\"node_budget\":%ld,\"ms_per_solve\":%.3f,\"nodes_per_solve\":%.0f}\n",
+               bandTop[band], solves[band], solved[band], config.nodes, solves[band] > 0 ? seconds[band] * 1e3 / solves[band] : 0.0,
+               solves[band] > 0 ? (double)nodes[band] / solves[band] : 0.0);
     }
-    else
+    fflush(stdout);
+    free(solver);
+    return 0;
+}
+
+// an Expert bot against a Hard one, stopped after a random number of turns before the end
+void makeBenchPosition(BenchPosition *position, Rng *rng)
+{
+    Player players[2] = {createBotPlayer(densityBot, NULL), createBotPlayer(hardBot, NULL)};
+    players[0].silent = players[1].silent = 1;
+    players[0].rng = players[1].rng = rng;
+    placeShips(&players[0]);
+    placeShips(&players[1]);
+
+    int turns = rngBounded(rng, 2 * 60);
+    for (int t = 0; t < turns; t++)
     {
-        printf("\nResult: miss!\n");
+        Player *player = &players[t % 2];
+        Player *opponent = &players[1 - t % 2];
+        if (makeMove(player, opponent))
+            updateGameState(opponent, player);
+        if (opponent->shipsSunk == SHIPS_COUNT - 1) // keep something to shoot at
+            break;
+    }
+
+    linkBenchPosition(position);
+    for (int i = 0; i < 2; i++)
+    {
+        copyPlayerState(&position->players[i], &players[i]);
+        freeAll(&players[i]);
     }
-    return 1;
 }
 
-void addCell(Cell **head, int row, int col)
+void linkBenchPosition(BenchPosition *position)
 {
-    if (inList(*head, row, col))
+    for (int i = 0; i < 2; i++)
     {
-        return;
+        Player *copy = &position->players[i];
+        copy->ships = position->ships[i];
+        copy->moves = position->moves[i];
+        copy->botsShipsCoord = &position->lists[i][0];
+        copy->botHitList = &position->lists[i][1];
+        copy->radaredList = &position->lists[i][2];
+        copy->foundShips = &position->lists[i][3];
+        copy->densityTracker = i == 0 ? &position->tracker : NULL;
     }
-    Cell *newCell = createCell(row, col);
-    newCell->next = *head; // insert at the head of the list
-    *head = newCell;
 }
 
-// remove a  hit from the list
-void removeCell(Cell **head, int row, int col)
+void copyPlayerState(Player *to, Player *from)
+{
+    Player kept = *to;
+    *to = *from;
+    to->rng = kept.rng;
+    to->arena = kept.arena;
+
+    to->ships = kept.ships;
+    to->moves = kept.moves;
+    memcpy(to->ships, from->ships, sizeof(Ship) * SHIPS_COUNT);
+    memcpy(to->moves, from->moves, sizeof(Move) * MOVES_COUNT);
+
+    to->botsShipsCoord = kept.botsShipsCoord;
+    to->botHitList = kept.botHitList;
+    to->radaredList = kept.radaredList;
+    to->foundShips = kept.foundShips;
+    *to->botsShipsCoord = *from->botsShipsCoord;
+    *to->botHitList = *from->botHitList;
+    *to->radaredList = *from->radaredList;
+    *to->foundShips = *from->foundShips;
+
+    to->endgame = kept.endgame; // holds nothing between moves
+    to->densityTracker = kept.densityTracker;
+    if (to->densityTracker != NULL && from->densityTracker != NULL)
+        *to->densityTracker = *from->densityTracker;
+}
+
+void benchKernel(int kernel, Player *bot, Player *opponent, UndoStack *stack)
 {
-    Cell *current = *head, *prev = NULL;
-    while (current != NULL)
+    int row, col;
+    bot->difficulty = hardBot;
+    switch (kernel)
     {
-        if (current->row == row && current->col == col)
-        {
-            if (prev == NULL)
-            { // Remove the head
-                *head = current->next;
-            }
-            else
-            {
-                prev->next = current->next;
-            }
-            free(current);
-            return;
-        }
-        prev = current;
-        current = current->next;
+    case 0:
+        fire(bot, opponent, 1);
+        break;
+    case 1:
+        radarSweep(bot, opponent);
+        break;
+    case 2:
+        smokeScreen(bot, opponent);
+        break;
+    case 3:
+        artillery(bot, opponent, 1);
+        break;
+    case 4:
+        torpedo(bot, opponent, 1);
+        break;
+    case 5: // on an empty board
+        clearBoard(&bot->board);
+        memset(bot->botsShipsCoord, 0, sizeof(CellSet));
+        botPlaceFleet(bot);
+        break;
+    case 6:
+        setCoordsMeaningfully(bot, opponent, &row, &col);
+        break;
+    case 7:
+        bot->difficulty = densityBot;
+        setCoordsMeaningfully(bot, opponent, &row, &col);
+        break;
+    case 8:
+        bot->difficulty = monteCarloBot;
+        setCoordsMeaningfully(bot, opponent, &row, &col);
+        break;
+    case 9:
+    {
+        PackedGame game;
+        Player *players[2] = {bot, opponent};
+        packGame(&game, players, bot->rng, 0, 0);
+        unpackGame(players, bot->rng, &game);
+        break;
+    }
+    case 10: // the same random cell as packedStrike
+        strike(bot, opponent, bbCell(randomCoordinate(bot->rng, GRID_SIZE), randomCoordinate(bot->rng, GRID_SIZE)));
+        break;
+    case 11:
+    {
+        PackedPlayer packed;
+        packPlayer(&packed, opponent); // plays the part of the restore, see packGame+unpackGame
+        packedStrike(&packed, bbCell(randomCoordinate(bot->rng, GRID_SIZE), randomCoordinate(bot->rng, GRID_SIZE)));
+        break;
+    }
+    default: // a random artillery strike, made and taken back
+        row = randomCoordinate(bot->rng, GRID_SIZE - 1);
+        col = randomCoordinate(bot->rng, GRID_SIZE - 1);
+        doMove(bot, opponent, 3, row, col, stack);
+        undoMove(bot, opponent, stack);
+        break;
     }
 }
 
-int randomCoordinate(int upperBound)
+/*---------------------------------------------------------------Latency-------------------------------------------------------------------*/
+
+uint64_t nanoseconds()
 {
-    return rand() % upperBound;
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
 }
 
-void checkOneRoundMoves(Player *player, int move)
+int latencyBucket(uint64_t ns)
 {
+    if (ns < (2ULL << LATENCY_SUB_BITS))
+        return (int)ns;
+    if (ns >> LATENCY_MAX_BITS)
+        return LATENCY_BUCKETS - 1;
+    int shift = highestBit64(ns) - LATENCY_SUB_BITS; // keeps the top LATENCY_SUB_BITS + 1 bits
+    return (shift << LATENCY_SUB_BITS) + (int)(ns >> shift);
+}
 
-    int movesToCheck[2] = {3, 4};
+uint64_t latencyBucketLimit(int bucket)
+{
+    if (bucket < (2 << LATENCY_SUB_BITS))
+        return bucket;
+    int shift = (bucket >> LATENCY_SUB_BITS) - 1;
+    uint64_t mantissa = bucket - ((uint64_t)shift << LATENCY_SUB_BITS);
+    return ((mantissa + 1) << shift) - 1;
+}
 
-    for (int i = 0; i < 2; i++)
+void latencyRecord(int difficulty, int move, uint64_t ns)
+{
+    if (difficulty < 0 || difficulty >= BOT_DIFFICULTIES) // not a bot's move
+        return;
+    LatencyHistogram *histogram = &latencyLocal[difficulty][move];
+    histogram->count++;
+    histogram->buckets[latencyBucket(ns)]++;
+    if (ns > histogram->max)
+        histogram->max = ns;
+}
+
+void latencyFlush()
+{
+    while (atomic_flag_test_and_set_explicit(&latencyLock, memory_order_acquire))
+        ; // only taken when a thread finishes
+    for (int d = 0; d < BOT_DIFFICULTIES; d++)
     {
-        if (move != movesToCheck[i] && player->moves[movesToCheck[i]].countAvailable == 1)
+        for (int m = 0; m < MOVES_COUNT; m++)
         {
-            player->moves[movesToCheck[i]].countAvailable--;
+            LatencyHistogram *from = &latencyLocal[d][m];
+            LatencyHistogram *to = &latencyTotal[d][m];
+            if (from->count == 0)
+                continue;
+            to->count += from->count;
+            if (from->max > to->max)
+                to->max = from->max;
+            for (int b = 0; b < LATENCY_BUCKETS; b++)
+                to->buckets[b] += from->buckets[b];
         }
     }
+    atomic_flag_clear_explicit(&latencyLock, memory_order_release);
+    memset(latencyLocal, 0, sizeof(latencyLocal));
 }
 
-int checkAvailable(Player *player, int move)
+// the smallest bucket limit at or below which percentile % of the moves fall, never above the max
+uint64_t latencyPercentile(LatencyHistogram *histogram, double percentile)
 {
-    if (player->moves[move].countAvailable == 0)
+    double exact = histogram->count * percentile / 100.0;
+    uint64_t rank = (uint64_t)exact < exact ? (uint64_t)exact + 1 : (uint64_t)exact; // rounded up
+    uint64_t seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++)
     {
-        printf("\nOops, you don't have an available %s move! You lost your turn :(\n", player->moves[move].name);
-        getchar();
-        return 0;
+        seen += histogram->buckets[b];
+        if (seen >= rank && seen > 0)
+            return latencyBucketLimit(b) < histogram->max ? latencyBucketLimit(b) : histogram->max;
     }
-    return 1;
+    return histogram->max;
 }
 
-int botCheckAvailable(Player *player, int moveChosen)
+void latencyReport()
 {
-    if (player->moves[moveChosen].countAvailable == 0)
+    const char *moveNames[MOVES_COUNT] = {"fire", "radar", "smoke", "artillery", "torpedo"};
+    latencyFlush(); // the calling thread's own share
+
+    printf("\nbot move latency (microseconds):\n");
+    printf("%-8s %-10s %12s %10s %10s %10s %10s\n", "bot", "move", "moves", "p50", "p99", "p99.9", "max");
+    for (int d = 0; d < BOT_DIFFICULTIES; d++)
     {
-        return 0;
+        for (int m = 0; m < MOVES_COUNT; m++)
+        {
+            LatencyHistogram *histogram = &latencyTotal[d][m];
+            if (histogram->count == 0)
+                continue;
+            printf("%-8s %-10s %12llu %10.2f %10.2f %10.2f %10.2f\n", difficultyName(d), moveNames[m],
+                   (unsigned long long)histogram->count, latencyPercentile(histogram, 50) / 1e3,
+                   latencyPercentile(histogram, 99) / 1e3, latencyPercentile(histogram, 99.9) / 1e3, histogram->max / 1e3);
+        }
     }
-    return 1;
 }
 
-void chooseTopLeftMeaningfully(Cell *head1, Cell *head2, int *row, int *col)
+/*-----------------------------------------------------------Instrumentation----------------------------------------------------------------*/
+
+#ifdef INSTRUMENT
+// time stamp counter where there is one, nanoseconds elsewhere
+uint64_t readCycles()
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    return __rdtsc();
+#elif defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+#endif
+}
+
+void probeRecord(int probe, uint64_t start)
+{
+    instrumentLocal.calls[probe]++;
+    instrumentLocal.cycles[probe] += readCycles() - start;
+}
+
+void instrumentFlush()
 {
-    Cell *current = head1;
-    while (current != NULL)
+    while (atomic_flag_test_and_set_explicit(&instrumentLock, memory_order_acquire))
+        ; // only taken when a thread finishes
+    for (int p = 0; p < PROBES; p++)
     {
-        if (!inList(head2, current->row, current->col))
-        {
-            chooseTopLeftMeaningfullyHelper(current, row, col);
-            return;
-        }
-        else
-        {
-            current = current->next;
-        }
+        instrumentTotal.calls[p] += instrumentLocal.calls[p];
+        instrumentTotal.cycles[p] += instrumentLocal.cycles[p];
     }
+    for (int c = 0; c < COUNTERS; c++)
+        instrumentTotal.counters[c] += instrumentLocal.counters[c];
+    atomic_flag_clear_explicit(&instrumentLock, memory_order_release);
+    memset(&instrumentLocal, 0, sizeof(InstrumentTable));
 }
 
-void chooseTopLeftMeaningfullyHelper(Cell *current, int *row, int *col)
+// stderr, so it never mixes with machine-readable output on stdout
+void instrumentReport()
 {
-    if (current->row < 9 && current->row >= 0 && current->col < 9 && current->col >= 0)
+    const char *probeNames[PROBES] = {"makeMove", "fire", "radarSweep", "smokeScreen", "artillery", "torpedo",
+                                      "setCoordsMeaningfully", "searchForHits", "cellSetContains", "transpositionProbe"};
+    const char *counterNames[COUNTERS] = {"rng draws", "allocations", "fleet sampling attempts", "radar retries",
+                                          "artillery retries", "random cell retries", "cell set adds",
+                                          "cell set length sum", "monte carlo attempts", "transposition probes",
+                                          "transposition hits", "transposition stores", "tablebase probes",
+                                          "tablebase hits", "opening book probes", "opening book hits"};
+    InstrumentTable *total = &instrumentTotal;
+    instrumentFlush(); // the calling thread's own share
+
+    fprintf(stderr, "\n%-24s %14s %16s %12s\n", "function", "calls", "cycles", "cycles/call");
+    for (int p = 0; p < PROBES; p++)
     {
-        *row = current->row;
-        *col = current->col;
+        fprintf(stderr, "%-24s %14llu %16llu %12.1f\n", probeNames[p], (unsigned long long)total->calls[p],
+                (unsigned long long)total->cycles[p], total->calls[p] > 0 ? (double)total->cycles[p] / total->calls[p] : 0.0);
     }
-    else if (!(current->row < 9 && current->row >= 0) && (current->col < 9 && current->col >= 0))
+    fprintf(stderr, "\n%-24s %14s\n", "counter", "value");
+    for (int c = 0; c < COUNTERS; c++)
+        fprintf(stderr, "%-24s %14llu\n", counterNames[c], (unsigned long long)total->counters[c]);
+    if (total->counters[counterCellSetAdds] > 0)
+        fprintf(stderr, "%-24s %14.2f\n", "average cell set length", (double)total->counters[counterCellSetLength] / total->counters[counterCellSetAdds]);
+    if (total->counters[counterTranspositionProbes] > 0)
+        fprintf(stderr, "%-24s %13.2f%%\n", "transposition hit rate", 100.0 * total->counters[counterTranspositionHits] / total->counters[counterTranspositionProbes]);
+    if (total->counters[counterOpeningProbes] > 0)
+        fprintf(stderr, "%-24s %13.2f%%\n", "opening book hit rate", 100.0 * total->counters[counterOpeningHits] / total->counters[counterOpeningProbes]);
+    if (total->counters[counterTablebaseProbes] > 0)
+        fprintf(stderr, "%-24s %13.2f%%\n", "tablebase hit rate", 100.0 * total->counters[counterTablebaseHits] / total->counters[counterTablebaseProbes]);
+}
+#endif
+
+/*-------------------------------------------------------------Tournament-------------------------------------------------------------------*/
+
+#define GAMES_PER_TASK 64 // granularity of work stealing
+
+char *difficultyName(int difficulty)
+{
+    switch (difficulty)
     {
-        *row = current->row - 1;
-        *col = current->col;
+    case 0:
+        return "Easy";
+    case 1:
+        return "Medium";
+    case 2:
+        return "Hard";
+    case 3:
+        return "Expert";
+    default:
+        return "Master";
     }
-    else if (!(current->col < 9 && current->col >= 0) && (current->row < 9 && current->row >= 0))
+}
+
+int runTournament(int argc, char *argv[])
+{
+    long gamesPerPairing = atol(argv[2]);
+    int threads = cpuCount();
+    int scaling = 0;
+    uint64_t seed = (uint64_t)time(NULL);
+    for (int i = 3; i < argc; i++)
     {
-        *col = current->col - 1;
-        *row = current->row;
+        if (strcmp(argv[i], "--scaling") == 0)
+            scaling = 1;
+        else if (strncmp(argv[i], "--seed=", 7) == 0)
+            seed = strtoull(argv[i] + 7, NULL, 10);
+        else
+            threads = atoi(argv[i]);
     }
-    else
+    if (gamesPerPairing <= 0 || threads <= 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    PairingStats total[BOT_DIFFICULTIES * BOT_DIFFICULTIES];
+    long steals = 0;
+    double seconds = playTournament(threads, gamesPerPairing, seed, total, &steals);
+    long games = gamesPerPairing * BOT_DIFFICULTIES * BOT_DIFFICULTIES;
+
+    printf("seed: %llu\n", (unsigned long long)seed);
+    printf("%-16s %10s %10s %10s %10s %10s\n", "pairing", "games", "bot1 win%", "bot2 win%", "unfinished", "avg turns");
+    for (int p = 0; p < BOT_DIFFICULTIES * BOT_DIFFICULTIES; p++)
     {
-        *row = current->row - 1;
-        *col = current->col - 1;
+        PairingStats *stats = &total[p];
+        char pairing[32];
+        sprintf(pairing, "%s vs %s", difficultyName(p / BOT_DIFFICULTIES), difficultyName(p % BOT_DIFFICULTIES));
+        printf("%-16s %10ld %10.2f %10.2f %10ld %10.2f\n", pairing, stats->games,
+               100.0 * stats->wins[0] / stats->games, 100.0 * stats->wins[1] / stats->games,
+               stats->unfinished, (double)stats->turns / stats->games);
     }
-}
+    printf("\n%ld games on %d threads in %.3f s: %.0f games/sec (%ld steals)\n", games, threads, seconds, games / seconds, steals);
 
-int validTopLeftCoordinate(int row, int col)
-{
-    if (row < 9 && row >= 0 && col < 9 && col >= 0)
+    if (scaling) // same tournament again from 1 thread up to the chosen count
     {
-        return 1;
+        printf("\n%8s %12s %10s %10s\n", "threads", "games/sec", "speedup", "efficiency");
+        double baseRate = 0;
+        for (int t = 1;; t *= 2) // 1, 2, 4, ..., threads
+        {
+            if (t > threads)
+                t = threads;
+            double rate = games / playTournament(t, gamesPerPairing, seed, total, &steals);
+            if (t == 1)
+                baseRate = rate;
+            printf("%8d %12.0f %10.2f %9.1f%%\n", t, rate, rate / baseRate, 100.0 * rate / baseRate / t);
+            if (t == threads)
+                break;
+        }
     }
-    printf("\nInvalid coordinates! You lost your turn :(\n");
-    getchar();
     return 0;
 }
 
-Cell *createCell(int col, int row)
+// plays gamesPerPairing games of every difficulty pairing, returns the wall time it took
+double playTournament(int threads, long gamesPerPairing, uint64_t seed, PairingStats *total, long *steals)
 {
-    Cell *newCell = (Cell *)malloc(sizeof(Cell));
-    if (newCell == NULL)
+    int pairings = BOT_DIFFICULTIES * BOT_DIFFICULTIES;
+    long taskCount = pairings * ((gamesPerPairing + GAMES_PER_TASK - 1) / GAMES_PER_TASK);
+
+    TournamentWorker *workers = (TournamentWorker *)calloc(threads, sizeof(TournamentWorker));
+    countAllocation();
+    if (workers == NULL)
     {
         printf("Failed to allocate needed memory\n");
         exit(1);
     }
-    newCell->col = col;
-    newCell->row = row;
-    newCell->next = NULL;
-    return newCell;
-}
+    for (int w = 0; w < threads; w++)
+    {
+        workers[w].id = w;
+        workers[w].workerCount = threads;
+        workers[w].workers = workers;
+        workers[w].seed = seed;
+        workers[w].arena = createArena(GAME_ARENA_BYTES);
+        if (recordPath != NULL) // one log per thread, games land in whichever order the threads play them
+        {
+            char path[1024];
+            snprintf(path, sizeof(path), "%s.%d", recordPath, w);
+            workers[w].replay = openReplayWriter(path);
+            if (workers[w].replay == NULL)
+            {
+                printf("Cannot create %s\n", path);
+                exit(1);
+            }
+        }
+        workers[w].deque.tasks = (GameTask *)malloc(sizeof(GameTask) * (taskCount / threads + 1));
+        countAllocation();
+        if (workers[w].deque.tasks == NULL)
+        {
+            printf("Failed to allocate needed memory\n");
+            exit(1);
+        }
+        atomic_init(&workers[w].deque.top, 0);
+        atomic_init(&workers[w].deque.bottom, 0);
+    }
 
-int inList(Cell *head, int row, int col)
-{
-    Cell *current = head;
-    while (current != NULL)
+    // deal the tasks round-robin before any thread starts, so the deques never grow
+    long dealt = 0;
+    for (int p = 0; p < pairings; p++)
     {
-        if (current->col == col && current->row == row)
+        for (long g = 0; g < gamesPerPairing; g += GAMES_PER_TASK)
         {
-            return 1;
+            TaskDeque *deque = &workers[dealt % threads].deque;
+            long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+            deque->tasks[bottom].pairing = p;
+            deque->tasks[bottom].firstGame = g;
+            deque->tasks[bottom].games = (int)(gamesPerPairing - g < GAMES_PER_TASK ? gamesPerPairing - g : GAMES_PER_TASK);
+            atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+            dealt++;
         }
-        current = current->next;
     }
-    return 0;
-}
 
-void updateGameState(Player *opponent, Player *player)
-{
+    double start = wallSeconds();
+    runWorkers(threads, tournamentWorkerMain, workers, sizeof(TournamentWorker));
+    double seconds = wallSeconds() - start;
 
-    for (int i = 0; i < SHIPS_COUNT; i++)
+    memset(total, 0, sizeof(PairingStats) * pairings);
+    *steals = 0;
+    int failed = 0;
+    for (int w = 0; w < threads; w++)
     {
-        if (opponent->ships[i].remainingHits == 0)
+        for (int p = 0; p < pairings; p++)
+            mergePairingStats(&total[p], &workers[w].stats[p]);
+        *steals += workers[w].steals;
+        free(workers[w].deque.tasks);
+        freeArena(&workers[w].arena);
+        if (workers[w].replay != NULL && !closeReplayWriter(workers[w].replay))
         {
-            opponent->ships[i].remainingHits--; // when we sink the next ship, the current sunk ship has remaining hits = -1, so we do not print about it :)
-            opponent->shipsSunk++;
-            printf("\nOne of %s's ships, a %s, has been sunk!\n", opponent->name, getShipName(i + 2));
-            updateMoves(opponent, player);
+            printf("Cannot write %s.%d\n", recordPath, w);
+            failed = 1;
         }
     }
+    if (failed) // an incomplete log must not pass for a whole tournament
+        exit(1);
+    free(workers);
+    return seconds;
 }
 
-void updateMoves(Player *opponent, Player *player)
+void tournamentWorkerMain(void *arg)
 {
-    for (int j = 0; j < MOVES_COUNT; j++)
+    TournamentWorker *worker = (TournamentWorker *)arg;
+    GameTask task;
+
+    while (1)
     {
-        if (player->moves[j].shipsSunkToUnlock <= opponent->shipsSunk)
+        int found = popTask(&worker->deque, &task);
+
+        // own deque is empty: steal from the others, starting with the next worker
+        for (int i = 1; !found && i < worker->workerCount; i++)
         {
-            player->moves[j].countAvailable++;
+            TaskDeque *victim = &worker->workers[(worker->id + i) % worker->workerCount].deque;
+            int stolen;
+            while ((stolen = stealTask(victim, &task)) < 0)
+                ; // lost a race with another thief, the victim may still have work
+            if (stolen)
+            {
+                found = 1;
+                worker->steals++;
+            }
+        }
+        if (!found) // tasks are only dealt up front, so every deque stays empty from now on
+        {
+            INSTRUMENT_FLUSH();
+            if (recordLatency)
+                latencyFlush();
+            return;
+        }
+
+        int difficulty1 = task.pairing / BOT_DIFFICULTIES;
+        int difficulty2 = task.pairing % BOT_DIFFICULTIES;
+        for (int g = 0; g < task.games; g++)
+        {
+            GameResult result = playHeadlessGame(difficulty1, difficulty2, gameSeed(worker->seed, task.pairing, task.firstGame + g), &worker->arena,
+                                                 worker->replay);
+            addGameResult(&worker->stats[task.pairing], &result);
         }
     }
 }
 
-int gameOver(Player *opponent, Player *player)
+// owner side: 1 and the task, or 0 if the deque is empty
+int popTask(TaskDeque *deque, GameTask *task)
 {
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
 
-    if (opponent->shipsSunk == 4)
+    if (top > bottom) // empty
     {
-        printf("All of %s's ships have been sunk! %s wins, congrats :)", opponent->name, player->name);
-        getchar();
-        return 1;
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return 0;
     }
-    return 0;
+    *task = deque->tasks[bottom];
+    if (top == bottom) // last task, race the thieves for it
+    {
+        int won = atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                          memory_order_seq_cst, memory_order_relaxed);
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return won;
+    }
+    return 1;
 }
 
-int strcmpIgnoreNull(char *str1, char *str2)
+// thief side: 1 and the task, 0 if the deque is empty, -1 if another thread won the race
+int stealTask(TaskDeque *deque, GameTask *task)
 {
-    int i = 0, j = 0;
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
 
-    while (str1[i] != '\0' || str2[j] != '\0')
-    {
-        while (str1[i] == '\0')
-            i++;
-        while (str2[j] == '\0')
-            j++;
+    if (top >= bottom)
+        return 0;
+    *task = deque->tasks[top];
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                 memory_order_seq_cst, memory_order_relaxed))
+        return -1;
+    return 1;
+}
 
-        if (str1[i] != str2[j])
-        {
-            return 0;
-        }
+void addGameResult(PairingStats *stats, GameResult *result)
+{
+    stats->games++;
+    if (result->winner < 0)
+        stats->unfinished++;
+    else
+        stats->wins[result->winner]++;
+    stats->turns += result->turns;
+    for (int i = 0; i < MOVES_COUNT; i++)
+        stats->movesUsed[i] += result->movesUsed[0][i] + result->movesUsed[1][i];
+}
 
-        i++;
-        j++;
-    }
+void mergePairingStats(PairingStats *into, PairingStats *from)
+{
+    into->games += from->games;
+    into->wins[0] += from->wins[0];
+    into->wins[1] += from->wins[1];
+    into->unfinished += from->unfinished;
+    into->turns += from->turns;
+    for (int i = 0; i < MOVES_COUNT; i++)
+        into->movesUsed[i] += from->movesUsed[i];
+}
 
-    return 1;
+#ifdef _WIN32
+DWORD WINAPI threadTrampoline(LPVOID param)
+{
+    Thread *thread = (Thread *)param;
+    thread->routine(thread->arg);
+    return 0;
 }
+#else
+void *threadTrampoline(void *param)
+{
+    Thread *thread = (Thread *)param;
+    thread->routine(thread->arg);
+    return NULL;
+}
+#endif
 
-void freeAll(Player *player)
+void startThread(Thread *thread, ThreadRoutine routine, void *arg)
 {
-    for (int i = 0; i < 10; i++)
+    thread->routine = routine;
+    thread->arg = arg;
+#ifdef _WIN32
+    thread->handle = CreateThread(NULL, 0, threadTrampoline, thread, 0, NULL);
+    if (thread->handle == NULL)
+#else
+    if (pthread_create(&thread->handle, NULL, threadTrampoline, thread) != 0)
+#endif
     {
-        free(player->grid[i]);
+        printf("Failed to start a thread\n");
+        exit(1);
     }
-    free(player->grid);
-    free(player->ships);
-    free(player->moves);
-    freeList(player->smokedCells);
+}
 
-    if (player->isBot)
-    {
-        freeList(player->botHitList);
-        freeList(player->botsShipsCoord);
-        freeList(player->radaredList);
-        freeList(player->foundShips);
-    }
+void joinThread(Thread *thread)
+{
+#ifdef _WIN32
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+#else
+    pthread_join(thread->handle, NULL);
+#endif
 }
 
-void freeList(CellList *list)
+// routine on every worker at once, worker 0 on the calling thread; returns when all are done
+void runWorkers(int threads, ThreadRoutine routine, void *workers, size_t stride)
 {
-    if (list == NULL)
-        return;
-    Cell *current = list->head;
-    while (current != NULL)
+    Thread *handles = (Thread *)malloc(sizeof(Thread) * threads);
+    countAllocation();
+    if (handles == NULL)
     {
-        Cell *temp = current;
-        current = current->next;
-        free(temp);
+        printf("Failed to allocate needed memory\n");
+        exit(1);
     }
-    free(list);
+    for (int w = 1; w < threads; w++)
+        startThread(&handles[w], routine, (unsigned char *)workers + w * stride);
+    routine(workers); // the calling thread works too
+    for (int w = 1; w < threads; w++)
+        joinThread(&handles[w]);
+    free(handles);
+}
+
+int cpuCount()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
+}
+
+double wallSeconds()
+{
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return now.tv_sec + now.tv_nsec / 1e9;
 }